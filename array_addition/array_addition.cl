@@ -6,4 +6,97 @@
  __kernel void sumArrays(__global int* a, __global int* b, __global int* c){
      int index = get_global_id(0);
      c[index] = a[index] + b[index];
- }
\ No newline at end of file
+ }
+
+/**
+ * These kernel functions sum two arrays of integers with vector types, so that
+ * each work-item processes 4, 8 or 16 consecutive elements. The host sums the
+ * last N % width elements (if any) with the scalar kernel above.
+ **/
+
+ __kernel void sumArrays4(__global int4* a, __global int4* b, __global int4* c){
+     int index = get_global_id(0);
+     c[index] = a[index] + b[index];
+ }
+
+ __kernel void sumArrays8(__global int8* a, __global int8* b, __global int8* c){
+     int index = get_global_id(0);
+     c[index] = a[index] + b[index];
+ }
+
+ __kernel void sumArrays16(__global int16* a, __global int16* b, __global int16* c){
+     int index = get_global_id(0);
+     c[index] = a[index] + b[index];
+ }
+
+/**
+ * These kernel functions are the grid-stride versions of the ones above: a
+ * fixed number of work-items (sized to the compute units of the device, not to
+ * the arrays) loop over the N elements (or vectors), so that large arrays do
+ * not create millions of short-lived work-items.
+ **/
+
+ __kernel void sumArraysStrided(__global int* a, __global int* b, __global int* c, const int N){
+     for(int index = get_global_id(0); index < N; index += get_global_size(0)){
+         c[index] = a[index] + b[index];
+     }
+ }
+
+ __kernel void sumArraysStrided4(__global int4* a, __global int4* b, __global int4* c, const int N){
+     for(int index = get_global_id(0); index < N; index += get_global_size(0)){
+         c[index] = a[index] + b[index];
+     }
+ }
+
+ __kernel void sumArraysStrided8(__global int8* a, __global int8* b, __global int8* c, const int N){
+     for(int index = get_global_id(0); index < N; index += get_global_size(0)){
+         c[index] = a[index] + b[index];
+     }
+ }
+
+ __kernel void sumArraysStrided16(__global int16* a, __global int16* b, __global int16* c, const int N){
+     for(int index = get_global_id(0); index < N; index += get_global_size(0)){
+         c[index] = a[index] + b[index];
+     }
+ }
+
+/**
+ * This kernel function sums a batch of arrays packed one after another, whose
+ * segment s spans the elements offsets[s] to offsets[s + 1] - 1. Each
+ * work-group sums one segment, looping over it with the stride of its size.
+ **/
+
+ __kernel void sumArraysSegmented(__global int* a, __global int* b, __global int* c, __global int* offsets){
+     int segment = get_group_id(0);
+     int end = offsets[segment + 1];
+     for(int index = offsets[segment] + get_local_id(0); index < end; index += get_local_size(0)){
+         c[index] = a[index] + b[index];
+     }
+ }
+
+/**
+ * This kernel function sums two arrays of ELEMENT_TYPE, which the host sets
+ * through the build options (with ENABLE_FP64 or ENABLE_FP16 for double and
+ * half). Without cl_khr_fp16, half arrays are built with HALF_STORAGE instead:
+ * they are only stored as half, and summed as float.
+ **/
+
+#ifdef ENABLE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#ifdef ENABLE_FP16
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+#endif
+
+#if defined(HALF_STORAGE)
+ __kernel void sumArraysTyped(__global half* a, __global half* b, __global half* c){
+     int index = get_global_id(0);
+     vstore_half(vload_half(index, a) + vload_half(index, b), index, c);
+ }
+#elif defined(ELEMENT_TYPE)
+ __kernel void sumArraysTyped(__global ELEMENT_TYPE* a, __global ELEMENT_TYPE* b, __global ELEMENT_TYPE* c){
+     int index = get_global_id(0);
+     c[index] = a[index] + b[index];
+ }
+#endif
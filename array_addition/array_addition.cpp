@@ -1,39 +1,160 @@
 #include <CL/cl.hpp>
-#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
-#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "../common/benchmark.hpp"
+#include "../common/buffer_pool.hpp"
+#include "../common/element_type.hpp"
+#include "../common/expression.hpp"
+#include "../common/options.hpp"
+#include "../common/profiler.hpp"
+#include "../common/report.hpp"
+#include "../common/runtime.hpp"
 
 // =================================================================
-// ---------------------- Secondary Functions ----------------------
+// ------------------------ Launch Constants -----------------------
+// =================================================================
+
+const int STRIDE_GROUPS_PER_UNIT = 4;   // Work-groups launched per compute unit in grid-stride mode.
+const int STRIDE_MIN_ITERATIONS = 8;    // Iterations per work-item from which grid-stride mode is used.
+
+// =================================================================
+// ---------------------- Session Structures -----------------------
 // =================================================================
 
-cl::Device getDefaultDevice();                          // Return the first device found in this OpenCL platform.
-void initializeDevice();                                // Inicialize device and compile kernel code.
-void seqSumArrays(int* a, int* b, int* c, const int N); // Sequentially performs the N-dimensional operation c = a + b.
-void parSumArrays(int* a, int* b, int* c, const int N); // Parallelly performs the N-dimensional operation c = a + b.
-bool checkEquality(int* c1, int* c2, const int N);      // Check if the N-dimensional arrays c1 and c2 are equal.
+/**
+ * Device objects reused by consecutive calls to parSumArrays, so that
+ * each call only transfers data and runs the kernel.
+ * */
+
+struct SumArraysSession {
+    cl::Kernel kernel;      // The scalar kernel, created on the first call.
+    cl::Kernel vectorKernel;// The vector kernel, if vectorWidth is greater than 1.
+    int vectorWidth = 0;    // The number of elements summed by each work-item.
+    cl::Kernel strideKernel;// The grid-stride version of the (vector) kernel.
+    size_t strideGlobal = 0;// The number of work-items of the grid-stride launch.
+    size_t strideLocal = 0; // The work-group size of the grid-stride launch.
+    std::string launch;     // The launch shape: "auto", "items" or "stride".
+    cl::Buffer aBuf;        // The device copy of the input array a.
+    cl::Buffer bBuf;        // The device copy of the input array b.
+    cl::Buffer cBuf;        // The device copy of the output array c.
+    size_t capacity = 0;    // The number of elements the buffers can hold.
+    std::string transfer;   // The transfer path: "copy" (write/read) or "map" ("auto" or empty to choose).
+    int* hostA = NULL;      // The host array a used in place by aBuf, if any.
+    int* hostB = NULL;      // The host array b used in place by bBuf, if any.
+    int* hostC = NULL;      // The host array c used in place by cBuf, if any.
+};
+
+/**
+ * One of the arrays of a batch summed by parSumArraysBatched, which
+ * performs c = a + b over its size elements.
+ * */
+
+struct ArraySegment {
+    int* a;                 // The input array a.
+    int* b;                 // The input array b.
+    int* c;                 // The output array c.
+    int size;               // The number of elements of the arrays.
+};
+
+/**
+ * Objects reused by consecutive calls to parSumArraysBatched: the kernel
+ * and the host arrays where the segments are packed.
+ * */
+
+struct SumArraysBatchSession {
+    cl::Kernel kernel;          // The segmented kernel, created on the first call.
+    size_t local;               // The size of the work-groups of the kernel.
+    std::vector<int> a;         // The packed input arrays a.
+    std::vector<int> b;         // The packed input arrays b.
+    std::vector<int> c;         // The packed output arrays c.
+    std::vector<int> offsets;   // The first element of each segment, and the total size.
+};
+
+/**
+ * Worker threads of cpuSumArrays, started once so that each call only
+ * dispatches its ranges to them. Each call is a job: the workers wait for
+ * a new job number, sum their range and count themselves out of pending.
+ * */
+
+struct CpuWorkerPool {
+    std::vector<std::thread> workers;   // The worker threads (the calling thread sums the last range).
+    std::mutex mutex;                   // Guards the fields below.
+    std::condition_variable wake;       // Notifies the workers of a new job, or of stop.
+    std::condition_variable done;       // Notifies the caller that pending reached 0.
+    unsigned long job = 0;              // The number of jobs dispatched so far.
+    size_t pending = 0;                 // The workers still summing the current job.
+    bool stop = false;                  // Whether the workers must exit.
+    void (*sumRange)(const int*, const int*, int*, size_t, size_t) = NULL; // The SIMD implementation.
+    const int* a = NULL;                // The input array a of the current job.
+    const int* b = NULL;                // The input array b of the current job.
+    int* c = NULL;                      // The output array c of the current job.
+    size_t N = 0;                       // The number of elements of the current job.
+    size_t range = 0;                   // The number of elements summed by each thread.
+};
 
 // =================================================================
-// ------------------------ Global Variables ------------------------
+// ---------------------- Secondary Functions ----------------------
 // =================================================================
 
-cl::Program program;    // The program that will run on the device.    
-cl::Context context;    // The context which holds the device.    
-cl::Device device;      // The device where the kernel will run.
+void seqSumArrays(int* a, int* b, int* c, const int N);     // Sequentially performs the N-dimensional operation c = a + b.
+void parSumArrays(SumArraysSession& session,
+                  int* a, int* b, int* c, const int N);     // Parallelly performs the N-dimensional operation c = a + b.
+void parSumArraysMapped(SumArraysSession& session,
+                        int* a, int* b, int* c, const int N); // Parallelly performs c = a + b mapping the buffers instead of copying them.
+void setSumArraysArgs(SumArraysSession& session);           // Set the arguments of the kernels of a session to its buffers.
+void enqueueSumArrays(SumArraysSession& session,
+                      const int N);                         // Enqueue the kernels summing the buffers of a session.
+void startCpuWorkers(CpuWorkerPool& pool, int threads);     // Start the worker threads of cpuSumArrays.
+void stopCpuWorkers(CpuWorkerPool& pool);                   // Stop and join the worker threads of cpuSumArrays.
+void cpuSumArrays(CpuWorkerPool& pool,
+                  int* a, int* b, int* c, const int N);     // Performs c = a + b on every CPU core with SIMD instructions.
+const char* getCpuSimdName();                               // Return the SIMD instruction set used by cpuSumArrays.
+void seqFusedArrays(int* a, int* b, int* e, int* d,
+                    const int N, int lo, int hi);           // Sequentially performs the N-dimensional operation d = clamp((a + b) * e, lo, hi).
+void parSumArraysStreamed(int* a, int* b, int* c,
+                          const int N, size_t chunkSize,
+                          int depth);                       // Parallelly performs c = a + b in chunks streamed through the device.
+bool fitsDevice(const int N);                               // Check if the buffers of N-dimensional arrays fit in the device.
+void parSumArraysBatched(SumArraysBatchSession& session,
+                         const std::vector<ArraySegment>& segments); // Parallelly performs c = a + b for every segment in one launch.
+bool checkEquality(int* c1, int* c2, const int N);          // Check if the N-dimensional arrays c1 and c2 are equal.
+int getVectorWidth();                                       // Return the vector width used by parSumArrays.
+template<class T>
+void seqSumArraysOf(const T* a, const T* b, T* c,
+                    const int N);                           // Sequentially performs c = a + b over arrays of T.
+template<class T>
+void parSumArraysOf(const T* a, const T* b, T* c,
+                    const int N);                           // Parallelly performs c = a + b over arrays of T.
+template<class T>
+bool benchmarkArraysOf(const int N,
+                       const BenchmarkOptions& options,
+                       std::vector<BenchmarkResult>& results); // Benchmark parSumArraysOf<T> and check its result.
+bool useGridStride(const SumArraysSession& session,
+                   const int items);                        // Check if parSumArrays should launch items in grid-stride mode.
 
 // =================================================================
 // ------------------------- Main Function -------------------------
 // =================================================================
 
-int main(){
+int main(int argc, char** argv){
     
     /**
-     * Create auxiliary variables.
+     * Read the benchmark options.
      * */
 
-    clock_t start, end;
-    const int EXECUTIONS = 10;
+    parseOptions(argc, argv);
+    BenchmarkOptions options = getBenchmarkOptions(10);
 
     /**
      * Prepare input arrays.
@@ -42,6 +163,10 @@ int main(){
     int ARRAYS_DIM = 1 << 20;
     std::vector<int> a(ARRAYS_DIM, 3);
     std::vector<int> b(ARRAYS_DIM, 5);
+    const double BYTES = 3.0 * ARRAYS_DIM * sizeof(int);
+    beginReport("array_addition");
+    addReportParameter("N", ARRAYS_DIM);
+    addReportParameter("local_size", "auto");
 
     /**
      * Prepare sequential and parallel outputs.
@@ -54,35 +179,161 @@ int main(){
      * Sequentially sum arrays.
      * */
 
-    start = clock();
-    for(int i = 0; i < EXECUTIONS; i++){
+    BenchmarkResult seqResult = runBenchmark("Sequential", [&]{
         seqSumArrays(a.data(), b.data(), cs.data(), ARRAYS_DIM);
-    }
-    end = clock();
-    double seqTime = ((double) 10e3 * (end - start)) / CLOCKS_PER_SEC / EXECUTIONS;
+    }, options, BYTES, GIGABYTES_PER_SECOND);
+
+    /**
+     * Sum arrays on every CPU core with SIMD instructions, the fair
+     * baseline to decide whether offloading pays off (the threads are
+     * started before timing, as the device is initialized before it).
+     * */
+
+    const int CPU_THREADS = getIntOption("cpu-threads", "ARRAYS_CPU_THREADS", (int) std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<int> cc(ARRAYS_DIM);
+    CpuWorkerPool cpuPool;
+    startCpuWorkers(cpuPool, CPU_THREADS);
+    BenchmarkResult cpuResult = runBenchmark(std::string("CPU (") + getCpuSimdName() + ", " + std::to_string(CPU_THREADS) + " threads)", [&]{
+        cpuSumArrays(cpuPool, a.data(), b.data(), cc.data(), ARRAYS_DIM);
+    }, options, BYTES, GIGABYTES_PER_SECOND);
+    stopCpuWorkers(cpuPool);
 
     /**
      * Initialize OpenCL device.
      * */
 
-    initializeDevice();
+    initializeDevice("array_addition.cl");
 
     /**
-     * Parallelly sum arrays.
+     * Parallelly sum arrays once, which also creates the kernel
+     * and the device buffers of the session.
      * */
 
-    start = clock();
-    for(int i = 0; i < EXECUTIONS; i++){
-        parSumArrays(a.data(), b.data(), cp.data(), ARRAYS_DIM);
+    SumArraysSession session;
+    BenchmarkOptions firstCall;
+    firstCall.warmup = 0;
+    firstCall.repetitions = 1;
+    BenchmarkResult firstParResult = runBenchmark("Parallel (first call)", [&]{
+        parSumArrays(session, a.data(), b.data(), cp.data(), ARRAYS_DIM);
+    }, firstCall, BYTES, GIGABYTES_PER_SECOND);
+
+    /**
+     * Parallelly sum arrays reusing the session (steady state).
+     * */
+
+    BenchmarkResult parResult = runBenchmark("Parallel", [&]{
+        parSumArrays(session, a.data(), b.data(), cp.data(), ARRAYS_DIM);
+    }, options, BYTES, GIGABYTES_PER_SECOND);
+
+    /**
+     * Compare both transfer paths on arrays allocated as the device
+     * requires, which the map path uses in place (zero-copy).
+     * */
+
+    int* za = (int*) allocateHostMemory(ARRAYS_DIM * sizeof(int));
+    int* zb = (int*) allocateHostMemory(ARRAYS_DIM * sizeof(int));
+    int* zcc = (int*) allocateHostMemory(ARRAYS_DIM * sizeof(int));
+    int* zcm = (int*) allocateHostMemory(ARRAYS_DIM * sizeof(int));
+    std::copy(a.begin(), a.end(), za);
+    std::copy(b.begin(), b.end(), zb);
+
+    SumArraysSession copySession;
+    SumArraysSession mapSession;
+    copySession.transfer = "copy";
+    mapSession.transfer = "map";
+    BenchmarkResult copyResult = runBenchmark("Parallel (copy)", [&]{
+        parSumArrays(copySession, za, zb, zcc, ARRAYS_DIM);
+    }, options, BYTES, GIGABYTES_PER_SECOND);
+    BenchmarkResult mapResult = runBenchmark("Parallel (map)", [&]{
+        parSumArrays(mapSession, za, zb, zcm, ARRAYS_DIM);
+    }, options, BYTES, GIGABYTES_PER_SECOND);
+
+    /**
+     * Parallelly sum arrays in chunks pipelined over several queues, as
+     * parSumArrays does for arrays that do not fit in the device.
+     * */
+
+    const int CHUNK_SIZE = getIntOption("chunk-size", "ARRAYS_CHUNK_SIZE", ARRAYS_DIM / 8);
+    const int STREAM_DEPTH = getIntOption("stream-depth", "ARRAYS_STREAM_DEPTH", 3);
+    std::vector<int> cst(ARRAYS_DIM);
+    BenchmarkResult streamedResult = runBenchmark("Parallel (streamed)", [&]{
+        parSumArraysStreamed(a.data(), b.data(), cst.data(), ARRAYS_DIM, CHUNK_SIZE, STREAM_DEPTH);
+    }, options, BYTES, GIGABYTES_PER_SECOND);
+
+    /**
+     * Sum a batch of short arrays (of 1000 to 4999 elements), either
+     * one parSumArrays call per array or all of them in a single launch.
+     * */
+
+    const int SEGMENTS = getIntOption("segments", "ARRAYS_SEGMENTS", 2000);
+    std::vector<int> segmentSizes(SEGMENTS);
+    size_t segmentsDim = 0;
+    for(int s = 0; s < SEGMENTS; s++){
+        segmentSizes[s] = 1000 + (s * 7919) % 4000;
+        segmentsDim += segmentSizes[s];
+    }
+    std::vector<int> sa(segmentsDim, 3), sb(segmentsDim, 5), scs(segmentsDim), scp(segmentsDim), scb(segmentsDim);
+    std::vector<ArraySegment> seqSegments, parSegments, batchSegments;
+    for(int s = 0, offset = 0; s < SEGMENTS; offset += segmentSizes[s], s++){
+        seqSegments.push_back(ArraySegment{&sa[offset], &sb[offset], &scs[offset], segmentSizes[s]});
+        parSegments.push_back(ArraySegment{&sa[offset], &sb[offset], &scp[offset], segmentSizes[s]});
+        batchSegments.push_back(ArraySegment{&sa[offset], &sb[offset], &scb[offset], segmentSizes[s]});
     }
-    end = clock();
-    double parTime = ((double) 10e3 * (end - start)) / CLOCKS_PER_SEC / EXECUTIONS;
+    const double SEGMENTS_BYTES = 3.0 * segmentsDim * sizeof(int);
+
+    for(int s = 0; s < SEGMENTS; s++){
+        seqSumArrays(seqSegments[s].a, seqSegments[s].b, seqSegments[s].c, seqSegments[s].size);
+    }
+    BenchmarkResult perArrayResult = runBenchmark("Parallel (" + std::to_string(SEGMENTS) + " arrays, one call each)", [&]{
+        for(int s = 0; s < SEGMENTS; s++){
+            parSumArrays(session, parSegments[s].a, parSegments[s].b, parSegments[s].c, parSegments[s].size);
+        }
+    }, options, SEGMENTS_BYTES, GIGABYTES_PER_SECOND);
+
+    SumArraysBatchSession batchSession;
+    BenchmarkResult batchedResult = runBenchmark("Parallel (" + std::to_string(SEGMENTS) + " arrays, batched)", [&]{
+        parSumArraysBatched(batchSession, batchSegments);
+    }, options, SEGMENTS_BYTES, GIGABYTES_PER_SECOND);
+
+    /**
+     * Chain element-wise operations, d = clamp((a + b) * e, 0, 15),
+     * sequentially and in a single generated kernel, so that the
+     * intermediate arrays never leave the device registers.
+     * */
+
+    std::vector<int> e(ARRAYS_DIM, 2);
+    std::vector<int> ds(ARRAYS_DIM);
+    std::vector<int> dp(ARRAYS_DIM);
+    const double FUSED_BYTES = 4.0 * ARRAYS_DIM * sizeof(int);
+
+    BenchmarkResult seqFusedResult = runBenchmark("Sequential (fused)", [&]{
+        seqFusedArrays(a.data(), b.data(), e.data(), ds.data(), ARRAYS_DIM, 0, 15);
+    }, options, FUSED_BYTES, GIGABYTES_PER_SECOND);
+
+    BenchmarkResult fusedResult = runBenchmark("Parallel (fused)", [&]{
+        evaluate(clamp((array(a.data()) + array(b.data())) * array(e.data()), 0, 15), dp.data(), ARRAYS_DIM);
+    }, options, FUSED_BYTES, GIGABYTES_PER_SECOND);
+
+    /**
+     * Parallelly sum arrays of the other element types, so that their
+     * bandwidths can be compared.
+     * */
+
+    std::vector<BenchmarkResult> typedResults;
+    bool typedEqual = benchmarkArraysOf<float>(ARRAYS_DIM, options, typedResults);
+    typedEqual = benchmarkArraysOf<double>(ARRAYS_DIM, options, typedResults) && typedEqual;
+    typedEqual = benchmarkArraysOf<cl_long>(ARRAYS_DIM, options, typedResults) && typedEqual;
+    typedEqual = benchmarkArraysOf<Half>(ARRAYS_DIM, options, typedResults) && typedEqual;
 
     /**
      * Check if outputs are equal.
      * */
 
-    bool equal = checkEquality(cs.data(), cp.data(), ARRAYS_DIM);
+    bool equal = checkEquality(cs.data(), cp.data(), ARRAYS_DIM) && checkEquality(cs.data(), cst.data(), ARRAYS_DIM)
+              && checkEquality(cs.data(), cc.data(), ARRAYS_DIM)
+              && checkEquality(cs.data(), zcc, ARRAYS_DIM) && checkEquality(cs.data(), zcm, ARRAYS_DIM)
+              && checkEquality(scs.data(), scp.data(), segmentsDim) && checkEquality(scs.data(), scb.data(), segmentsDim)
+              && checkEquality(ds.data(), dp.data(), ARRAYS_DIM) && typedEqual;
 
     /**
      * Print results.
@@ -90,8 +341,73 @@ int main(){
 
     std::cout << "Status: " << (equal ? "SUCCESS!" : "FAILED!") << std::endl;
     std::cout << "Results: \n\ta[0] = " << a[0] << "\n\tb[0] = " << b[0] << "\n\tc[0] = a[0] + b[0] = " << cp[0] << std::endl;
-    std::cout << "Mean execution time: \n\tSequential: " << seqTime << " ms;\n\tParallel: " << parTime << " ms." << std::endl;
-    std::cout << "Performance gain: " << (100 * (seqTime - parTime) / parTime) << "\%\n";
+    std::cout << "Vector width: " << session.vectorWidth << std::endl;
+    std::cout << "Transfer path: " << session.transfer << std::endl;
+    std::cout << "Launch: " << (useGridStride(session, ARRAYS_DIM / session.vectorWidth) ? "grid-stride" : "one item per element")
+              << " (" << session.strideGlobal << " work-items in grid-stride mode)" << std::endl;
+    std::cout << "Execution time: " << std::endl;
+    printBenchmark(seqResult);
+    printBenchmark(cpuResult);
+    printBenchmark(firstParResult);
+    printBenchmark(parResult);
+    printBenchmark(copyResult);
+    printBenchmark(mapResult);
+    printBenchmark(streamedResult);
+    printBenchmark(perArrayResult);
+    printBenchmark(batchedResult);
+    printBenchmark(seqFusedResult);
+    printBenchmark(fusedResult);
+    for(size_t i = 0; i < typedResults.size(); i++){
+        printBenchmark(typedResults[i]);
+    }
+    std::cout << "Performance gain: " << (100 * (seqResult.medianMs - parResult.medianMs) / parResult.medianMs) << "\%\n";
+    std::cout << "Performance gain over the CPU: " << (100 * (cpuResult.medianMs - parResult.medianMs) / parResult.medianMs) << "\%\n";
+    printBufferPoolStats();
+    printProfile();
+
+    /**
+     * Write the structured record of this run, if requested.
+     * */
+
+    addReportParameter("vector_width", session.vectorWidth);
+    addReportParameter("transfer", session.transfer);
+    addReportParameter("chunk_size", CHUNK_SIZE);
+    addReportParameter("segments", SEGMENTS);
+    addReportParameter("stream_depth", STREAM_DEPTH);
+    addReportParameter("launch", useGridStride(session, ARRAYS_DIM / session.vectorWidth) ? "stride" : "items");
+    addReportParameter("cpu_simd", getCpuSimdName());
+    addReportParameter("cpu_threads", CPU_THREADS);
+    addReportBenchmark(seqResult);
+    addReportBenchmark(cpuResult);
+    addReportBenchmark(firstParResult);
+    addReportBenchmark(parResult);
+    addReportBenchmark(copyResult);
+    addReportBenchmark(mapResult);
+    addReportBenchmark(streamedResult);
+    addReportBenchmark(perArrayResult);
+    addReportBenchmark(batchedResult);
+    addReportBenchmark(seqFusedResult);
+    addReportBenchmark(fusedResult);
+    for(size_t i = 0; i < typedResults.size(); i++){
+        addReportBenchmark(typedResults[i]);
+    }
+    writeReport(equal);
+
+    /**
+     * Release OpenCL objects.
+     * */
+
+    releaseDevice();
+
+    /**
+     * Free the host arrays, once no buffer uses them.
+     * */
+
+    mapSession = SumArraysSession();
+    freeHostMemory(za);
+    freeHostMemory(zb);
+    freeHostMemory(zcc);
+    freeHostMemory(zcm);
     return 0;
 }
 
@@ -100,120 +416,676 @@ int main(){
 // =================================================================
 
 /**
- * Return the first device found in this OpenCL platform.
+ * Sequentially performs the N-dimensional operation c = a + b.
+ * */
+
+void seqSumArrays(int* a, int* b, int* c, const int N){
+    for(int i = 0; i < N; i++){
+        c[i] = a[i] + b[i];
+    }
+}
+
+/**
+ * Performs c[i] = a[i] + b[i] for begin <= i < end, one element at a time.
  * */
 
-cl::Device getDefaultDevice(){
-    
+static void sumRangeScalar(const int* a, const int* b, int* c, size_t begin, size_t end){
+    for(size_t i = begin; i < end; i++){
+        c[i] = a[i] + b[i];
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/**
+ * Performs c[i] = a[i] + b[i] for begin <= i < end, 4 elements at a time.
+ * */
+
+__attribute__((target("sse2")))
+static void sumRangeSSE2(const int* a, const int* b, int* c, size_t begin, size_t end){
+    size_t i = begin;
+    for(; i + 4 <= end; i += 4){
+        __m128i sum = _mm_add_epi32(_mm_loadu_si128((const __m128i*) (a + i)), _mm_loadu_si128((const __m128i*) (b + i)));
+        _mm_storeu_si128((__m128i*) (c + i), sum);
+    }
+    sumRangeScalar(a, b, c, i, end);
+}
+
+/**
+ * Performs c[i] = a[i] + b[i] for begin <= i < end, 8 elements at a time.
+ * */
+
+__attribute__((target("avx2")))
+static void sumRangeAVX2(const int* a, const int* b, int* c, size_t begin, size_t end){
+    size_t i = begin;
+    for(; i + 8 <= end; i += 8){
+        __m256i sum = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) (a + i)), _mm256_loadu_si256((const __m256i*) (b + i)));
+        _mm256_storeu_si256((__m256i*) (c + i), sum);
+    }
+    sumRangeScalar(a, b, c, i, end);
+}
+
+/**
+ * Performs c[i] = a[i] + b[i] for begin <= i < end, 16 elements at a time.
+ * */
+
+__attribute__((target("avx512f")))
+static void sumRangeAVX512(const int* a, const int* b, int* c, size_t begin, size_t end){
+    size_t i = begin;
+    for(; i + 16 <= end; i += 16){
+        __m512i sum = _mm512_add_epi32(_mm512_loadu_si512((const void*) (a + i)), _mm512_loadu_si512((const void*) (b + i)));
+        _mm512_storeu_si512((void*) (c + i), sum);
+    }
+    sumRangeScalar(a, b, c, i, end);
+}
+
+#endif
+
+/**
+ * Return the SIMD instruction set used by cpuSumArrays: the widest one
+ * supported by the CPU running the example (checked at runtime, so the
+ * executable does not need to be compiled for it).
+ * */
+
+const char* getCpuSimdName(){
+#if defined(__x86_64__) || defined(__i386__)
+    if(__builtin_cpu_supports("avx512f")){
+        return "avx512";
+    }
+    if(__builtin_cpu_supports("avx2")){
+        return "avx2";
+    }
+    if(__builtin_cpu_supports("sse2")){
+        return "sse2";
+    }
+#endif
+    return "scalar";
+}
+
+/**
+ * Run a worker thread of a pool: sum the range of index in every job
+ * dispatched by cpuSumArrays, until the pool is stopped.
+ * */
+
+static void runCpuWorker(CpuWorkerPool* pool, size_t index){
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    while(true){
+        pool->wake.wait(lock, [&]{ return pool->stop || pool->job != seen; });
+        if(pool->stop){
+            return;
+        }
+        seen = pool->job;
+        size_t begin = std::min(index * pool->range, pool->N);
+        size_t end = std::min(begin + pool->range, pool->N);
+        lock.unlock();
+        if(begin < end){
+            pool->sumRange(pool->a, pool->b, pool->c, begin, end);
+        }
+        lock.lock();
+        if(--pool->pending == 0){
+            pool->done.notify_one();
+        }
+    }
+}
+
+/**
+ * Start the worker threads of cpuSumArrays (one less than threads, since
+ * the calling thread also sums a range), selecting the widest SIMD
+ * instructions the CPU supports.
+ * */
+
+void startCpuWorkers(CpuWorkerPool& pool, int threads){
+    pool.sumRange = sumRangeScalar;
+#if defined(__x86_64__) || defined(__i386__)
+    std::string simd = getCpuSimdName();
+    if(simd == "avx512"){
+        pool.sumRange = sumRangeAVX512;
+    }
+    else if(simd == "avx2"){
+        pool.sumRange = sumRangeAVX2;
+    }
+    else if(simd == "sse2"){
+        pool.sumRange = sumRangeSSE2;
+    }
+#endif
+    for(int i = 0; i + 1 < std::max(threads, 1); i++){
+        pool.workers.push_back(std::thread(runCpuWorker, &pool, (size_t) i));
+    }
+}
+
+/**
+ * Stop and join the worker threads of cpuSumArrays.
+ * */
+
+void stopCpuWorkers(CpuWorkerPool& pool){
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.stop = true;
+    }
+    pool.wake.notify_all();
+    for(size_t i = 0; i < pool.workers.size(); i++){
+        pool.workers[i].join();
+    }
+    pool.workers.clear();
+}
+
+/**
+ * Performs the N-dimensional operation c = a + b on the CPU, splitting the
+ * arrays in one contiguous range per thread of the pool (a multiple of 64
+ * bytes long, so that threads do not share cache lines), summed with the
+ * widest SIMD instructions the CPU supports. The calling thread sums the
+ * last range while the workers sum theirs.
+ * */
+
+void cpuSumArrays(CpuWorkerPool& pool, int* a, int* b, int* c, const int N){
+
+    /**
+     * Dispatch a job with one range per thread.
+     * */
+
+    const size_t ALIGN = 64 / sizeof(int);
+    const size_t THREADS = pool.workers.size() + 1;
+    size_t range = ((N + THREADS - 1) / THREADS + ALIGN - 1) / ALIGN * ALIGN;
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.a = a;
+        pool.b = b;
+        pool.c = c;
+        pool.N = N;
+        pool.range = range;
+        pool.pending = pool.workers.size();
+        pool.job++;
+    }
+    pool.wake.notify_all();
+
     /**
-     * Search for all the OpenCL platforms available and check
-     * if there are any.
+     * Sum the last range and wait for the workers.
      * */
 
-    std::vector<cl::Platform> platforms;
-    cl::Platform::get(&platforms);
+    size_t begin = std::min(pool.workers.size() * range, (size_t) N);
+    size_t end = std::min(begin + range, (size_t) N);
+    if(begin < end){
+        pool.sumRange(a, b, c, begin, end);
+    }
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.done.wait(lock, [&]{ return pool.pending == 0; });
+}
+
+/**
+ * Parallelly performs the N-dimensional operation c = a + b.
+ * */
+
+void parSumArrays(SumArraysSession& session, int* a, int* b, int* c, const int N){
 
-    if (platforms.empty()){
-        std::cerr << "No platforms found!" << std::endl;
-        exit(1);
+    /**
+     * Stream the arrays through the device if they do not fit in it.
+     * */
+
+    if(!fitsDevice(N)){
+        parSumArraysStreamed(a, b, c, N, getIntOption("chunk-size", "ARRAYS_CHUNK_SIZE", 0), getIntOption("stream-depth", "ARRAYS_STREAM_DEPTH", 3));
+        return;
     }
 
     /**
-     * Search for all the devices on the first platform and check if
-     * there are any available.
+     * Create the kernels on the first call.
      * */
 
-    auto platform = platforms.front();
-    std::vector<cl::Device> devices;
-    platform.getDevices(CL_DEVICE_TYPE_ALL, &devices);
+    if(session.kernel() == NULL){
+        session.kernel = cl::Kernel(program, "sumArrays");
+        session.vectorWidth = getVectorWidth();
+        if(session.vectorWidth > 1){
+            session.vectorKernel = cl::Kernel(program, ("sumArrays" + std::to_string(session.vectorWidth)).c_str());
+        }
+
+        /**
+         * Size the grid-stride launch to the compute units of the
+         * device rather than to the arrays.
+         * */
+
+        std::string suffix = session.vectorWidth > 1 ? std::to_string(session.vectorWidth) : "";
+        session.strideKernel = cl::Kernel(program, ("sumArraysStrided" + suffix).c_str());
+        session.strideLocal = std::min<size_t>(256, session.strideKernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+        session.strideGlobal = session.strideLocal * STRIDE_GROUPS_PER_UNIT * device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+        session.launch = getOption("launch", "ARRAYS_LAUNCH", "auto");
+        if(session.launch != "auto" && session.launch != "items" && session.launch != "stride"){
+            std::cerr << "Unknown launch shape: " << session.launch << " (expected auto, items or stride)" << std::endl;
+            exit(1);
+        }
+
+        /**
+         * Map memory instead of copying it when the device shares it
+         * with the host, unless the session already has a transfer path.
+         * */
+
+        if(session.transfer.empty()){
+            session.transfer = getOption("transfer", "ARRAYS_TRANSFER", "auto");
+        }
+        if(session.transfer == "auto"){
+            session.transfer = device.getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>() ? "map" : "copy";
+        }
+        if(session.transfer != "copy" && session.transfer != "map"){
+            std::cerr << "Unknown transfer path: " << session.transfer << " (expected auto, copy or map)" << std::endl;
+            exit(1);
+        }
+    }
+
+    if(session.transfer == "map"){
+        parSumArraysMapped(session, a, b, c, N);
+        return;
+    }
+
+    /**
+     * (Re)allocate device memory only when the arrays do not fit
+     * in the current buffers.
+     * */
 
-    if (devices.empty()){
-        std::cerr << "No devices found!" << std::endl;
-        exit(1);
+    if(session.capacity < (size_t) N){
+        releaseBuffer(session.aBuf);
+        releaseBuffer(session.bBuf);
+        releaseBuffer(session.cBuf);
+        session.aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, N * sizeof(int));
+        session.bBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, N * sizeof(int));
+        session.cBuf = acquireBuffer(CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, N * sizeof(int));
+        session.capacity = N;
+        setSumArraysArgs(session);
     }
 
     /**
-     * Return the first device found.
+     * Transfer the inputs, execute the kernel function and collect its
+     * result. The queue is in-order, so only the last command blocks.
      * */
 
-    return devices.front();
+    queue.enqueueWriteBuffer(session.aBuf, CL_FALSE, 0, N * sizeof(int), a, NULL, profileEvent(HOST_TO_DEVICE, "write a"));
+    queue.enqueueWriteBuffer(session.bBuf, CL_FALSE, 0, N * sizeof(int), b, NULL, profileEvent(HOST_TO_DEVICE, "write b"));
+    enqueueSumArrays(session, N);
+    queue.enqueueReadBuffer(session.cBuf, CL_TRUE, 0, N * sizeof(int), c, NULL, profileEvent(DEVICE_TO_HOST, "read c"));
 }
 
 /**
- * Inicialize device and compile kernel code.
+ * Parallelly performs the N-dimensional operation c = a + b mapping the
+ * buffers into host memory instead of copying them, which avoids any copy
+ * on devices that share their memory with the host. If the three arrays
+ * are aligned as the device requires (see isHostAligned), the buffers use
+ * them in place (CL_MEM_USE_HOST_PTR) and no data is copied at all;
+ * otherwise, the arrays are copied to and from buffers allocated by the
+ * driver where the host can access them (CL_MEM_ALLOC_HOST_PTR).
  * */
 
-void initializeDevice(){
+void parSumArraysMapped(SumArraysSession& session, int* a, int* b, int* c, const int N){
+    bool inPlace = isHostAligned(a, N * sizeof(int)) && isHostAligned(b, N * sizeof(int)) && isHostAligned(c, N * sizeof(int));
 
     /**
-     * Select the first available device.
+     * (Re)create the buffers when they do not suit the arrays: wrap the
+     * arrays themselves, or allocate host-accessible buffers.
      * */
 
-    device = getDefaultDevice();
-    
+    if(inPlace && (session.hostA != a || session.hostB != b || session.hostC != c || session.capacity != (size_t) N)){
+        releaseBuffer(session.aBuf);
+        releaseBuffer(session.bBuf);
+        releaseBuffer(session.cBuf);
+        session.aBuf = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, N * sizeof(int), a);
+        session.bBuf = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, N * sizeof(int), b);
+        session.cBuf = cl::Buffer(context, CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, N * sizeof(int), c);
+        session.hostA = a;
+        session.hostB = b;
+        session.hostC = c;
+        session.capacity = N;
+        setSumArraysArgs(session);
+    }
+    else if(!inPlace && (session.hostA != NULL || session.capacity < (size_t) N)){
+        releaseBuffer(session.aBuf);
+        releaseBuffer(session.bBuf);
+        releaseBuffer(session.cBuf);
+        session.aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR | CL_MEM_HOST_WRITE_ONLY, N * sizeof(int));
+        session.bBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR | CL_MEM_HOST_WRITE_ONLY, N * sizeof(int));
+        session.cBuf = acquireBuffer(CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR | CL_MEM_HOST_READ_ONLY, N * sizeof(int));
+        session.hostA = session.hostB = session.hostC = NULL;
+        session.capacity = N;
+        setSumArraysArgs(session);
+    }
+
     /**
-     * Read OpenCL kernel file as a string.
+     * Hand the inputs to the device. Mapping a buffer for writing and
+     * unmapping it publishes the host data (in place, or copied into the
+     * mapped region) without reading the previous device contents.
      * */
 
-    std::ifstream kernel_file("array_addition.cl");
-    std::string src(std::istreambuf_iterator<char>(kernel_file), (std::istreambuf_iterator<char>()));
+    const cl::Buffer* inputs[] = {&session.aBuf, &session.bBuf};
+    const int* hostInputs[] = {a, b};
+    const char* labels[] = {"map a", "map b"};
+    for(int i = 0; i < 2; i++){
+        void* mapped = queue.enqueueMapBuffer(*inputs[i], inPlace ? CL_FALSE : CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, N * sizeof(int), NULL, profileEvent(HOST_TO_DEVICE, labels[i]));
+        if(!inPlace){
+            std::copy(hostInputs[i], hostInputs[i] + N, (int*) mapped);
+        }
+        queue.enqueueUnmapMemObject(*inputs[i], mapped);
+    }
 
     /**
-     * Compile kernel program which will run on the device.
+     * Execute the kernel function and map its result for reading, which
+     * leaves it in c (in place) or in the mapped region.
      * */
 
-    cl::Program::Sources sources(1, std::make_pair(src.c_str(), src.length() + 1));
-    context = cl::Context(device);
-    program = cl::Program(context, sources);
-    
-    auto err = program.build();
-    if(err != CL_BUILD_SUCCESS){
-        std::cerr << "Error!\nBuild Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device) 
-        << "\nBuild Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
-        exit(1);
+    enqueueSumArrays(session, N);
+    int* mapped = (int*) queue.enqueueMapBuffer(session.cBuf, CL_TRUE, CL_MAP_READ, 0, N * sizeof(int), NULL, profileEvent(DEVICE_TO_HOST, "map c"));
+    if(!inPlace){
+        std::copy(mapped, mapped + N, c);
     }
+    queue.enqueueUnmapMemObject(session.cBuf, mapped);
 }
 
 /**
- * Sequentially performs the N-dimensional operation c = a + b.
+ * Set the arguments of the kernels of a session to its buffers.
  * */
 
-void seqSumArrays(int* a, int* b, int* c, const int N){
+void setSumArraysArgs(SumArraysSession& session){
+    session.kernel.setArg(0, session.aBuf);
+    session.kernel.setArg(1, session.bBuf);
+    session.kernel.setArg(2, session.cBuf);
+    if(session.vectorWidth > 1){
+        session.vectorKernel.setArg(0, session.aBuf);
+        session.vectorKernel.setArg(1, session.bBuf);
+        session.vectorKernel.setArg(2, session.cBuf);
+    }
+    session.strideKernel.setArg(0, session.aBuf);
+    session.strideKernel.setArg(1, session.bBuf);
+    session.strideKernel.setArg(2, session.cBuf);
+}
+
+/**
+ * Enqueue the kernels summing the first N elements of the buffers of a
+ * session: whole vectors with the vector kernel (one work-item per vector,
+ * or a fixed grid looping over them), and the remaining elements with the
+ * scalar kernel (offset past the vectors).
+ * */
+
+void enqueueSumArrays(SumArraysSession& session, const int N){
+    int vectors = session.vectorWidth > 1 ? N / session.vectorWidth : 0;
+    int tail = N - vectors * session.vectorWidth;
+    if(useGridStride(session, session.vectorWidth > 1 ? vectors : N)){
+        session.strideKernel.setArg(3, session.vectorWidth > 1 ? vectors : N);
+        queue.enqueueNDRangeKernel(session.strideKernel, cl::NullRange, cl::NDRange(session.strideGlobal), cl::NDRange(session.strideLocal), NULL, profileEvent(KERNEL, session.vectorWidth > 1 ? "sumArraysStrided" + std::to_string(session.vectorWidth) : "sumArraysStrided"));
+        if(session.vectorWidth == 1){
+            tail = 0;
+        }
+    }
+    else if(vectors > 0){
+        queue.enqueueNDRangeKernel(session.vectorKernel, cl::NullRange, cl::NDRange(vectors), cl::NullRange, NULL, profileEvent(KERNEL, "sumArrays" + std::to_string(session.vectorWidth)));
+    }
+    if(tail > 0){
+        queue.enqueueNDRangeKernel(session.kernel, cl::NDRange(N - tail), cl::NDRange(tail), cl::NullRange, NULL, profileEvent(KERNEL, "sumArrays"));
+    }
+}
+
+/**
+ * Sequentially performs the N-dimensional operation d = clamp((a + b) * e, lo, hi).
+ * */
+
+void seqFusedArrays(int* a, int* b, int* e, int* d, const int N, int lo, int hi){
     for(int i = 0; i < N; i++){
-        c[i] = a[i] + b[i];
+        d[i] = std::min(std::max((a[i] + b[i]) * e[i], lo), hi);
     }
 }
 
 /**
- * Parallelly performs the N-dimensional operation c = a + b.
+ * Parallelly performs the N-dimensional operation c = a + b, splitting
+ * the arrays in chunks of chunkSize elements (or the largest chunks that
+ * fit in the device, if chunkSize is 0 or too large). Up to depth chunks
+ * are in flight at once, each on its own queue, so that the transfers of
+ * one chunk overlap with the computation of the others.
  * */
 
-void parSumArrays(int* a, int* b, int* c, const int N){
-    
+void parSumArraysStreamed(int* a, int* b, int* c, const int N, size_t chunkSize, int depth){
+    if(N <= 0){
+        return;
+    }
+
     /**
-     * Create buffers and allocate memory on the device.
+     * Size the chunks so that the buffers of depth chunks (rounded up
+     * by the buffer pool by at most 25%) fit in the device.
      * */
 
-    cl::Buffer aBuf(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, N * sizeof(int), a);
-    cl::Buffer bBuf(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, N * sizeof(int), b);
-    cl::Buffer cBuf(context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, N * sizeof(int));
+    depth = std::max(depth, 1);
+    cl_ulong maxBytes = std::min(device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>(), device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>() / (4 * depth));
+    size_t maxChunk = std::max<size_t>(1, maxBytes / sizeof(int));
+    if(chunkSize == 0 || chunkSize > maxChunk){
+        chunkSize = maxChunk;
+    }
 
     /**
-     * Set kernel arguments.
+     * Allocate the buffers of each in-flight chunk.
      * */
 
-    cl::Kernel kernel(program, "sumArrays");
-    kernel.setArg(0, aBuf);
-    kernel.setArg(1, bBuf);
-    kernel.setArg(2, cBuf);
+    size_t slots = std::min<size_t>(depth, (N + chunkSize - 1) / chunkSize);
+    std::vector<cl::Buffer> aBufs, bBufs, cBufs;
+    for(size_t s = 0; s < slots; s++){
+        aBufs.push_back(acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, chunkSize * sizeof(int)));
+        bBufs.push_back(acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, chunkSize * sizeof(int)));
+        cBufs.push_back(acquireBuffer(CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, chunkSize * sizeof(int)));
+    }
+
+    /**
+     * Enqueue every chunk on the queue of its slot. The queues are
+     * in-order, so a chunk only reuses the buffers of its slot after
+     * the previous chunk of that slot has been read back.
+     * */
+
+    cl::Kernel& kernel = getKernel("sumArrays");
+    for(size_t offset = 0, k = 0; offset < (size_t) N; offset += chunkSize, k++){
+        size_t count = std::min(chunkSize, N - offset);
+        size_t s = k % slots;
+        cl::CommandQueue& streamQueue = getStreamQueue(s);
+
+        streamQueue.enqueueWriteBuffer(aBufs[s], CL_FALSE, 0, count * sizeof(int), a + offset, NULL, profileEvent(HOST_TO_DEVICE, "write a (chunk)"));
+        streamQueue.enqueueWriteBuffer(bBufs[s], CL_FALSE, 0, count * sizeof(int), b + offset, NULL, profileEvent(HOST_TO_DEVICE, "write b (chunk)"));
+        kernel.setArg(0, aBufs[s]);
+        kernel.setArg(1, bBufs[s]);
+        kernel.setArg(2, cBufs[s]);
+        streamQueue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(count), cl::NullRange, NULL, profileEvent(KERNEL, "sumArrays (chunk)"));
+        streamQueue.enqueueReadBuffer(cBufs[s], CL_FALSE, 0, count * sizeof(int), c + offset, NULL, profileEvent(DEVICE_TO_HOST, "read c (chunk)"));
+        streamQueue.flush();
+    }
+
+    /**
+     * Wait for the last chunks and give the buffers back to the pool.
+     * */
+
+    for(size_t s = 0; s < slots; s++){
+        getStreamQueue(s).finish();
+        releaseBuffer(aBufs[s]);
+        releaseBuffer(bBufs[s]);
+        releaseBuffer(cBufs[s]);
+    }
+}
+
+/**
+ * Parallelly performs c = a + b for every segment of a batch in a single
+ * launch: the segments are packed one after another, with a table of
+ * their offsets, so that the whole batch takes one transfer per array,
+ * one kernel (a work-group per segment) and one read, instead of paying
+ * the latency of those commands for each segment.
+ * */
+
+void parSumArraysBatched(SumArraysBatchSession& session, const std::vector<ArraySegment>& segments){
+    if(segments.empty()){
+        return;
+    }
+
+    /**
+     * Create the kernel and choose its work-group size on the first call.
+     * */
+
+    if(session.kernel() == NULL){
+        session.kernel = cl::Kernel(program, "sumArraysSegmented");
+        session.local = std::min<size_t>(256, session.kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+    }
+
+    /**
+     * Pack the input segments and their offsets.
+     * */
+
+    session.offsets.resize(segments.size() + 1);
+    session.offsets[0] = 0;
+    for(size_t s = 0; s < segments.size(); s++){
+        session.offsets[s + 1] = session.offsets[s] + segments[s].size;
+    }
+    const int N = session.offsets.back();
+    if(N == 0){
+        return;
+    }
+    session.a.resize(N);
+    session.b.resize(N);
+    session.c.resize(N);
+    for(size_t s = 0; s < segments.size(); s++){
+        std::copy(segments[s].a, segments[s].a + segments[s].size, session.a.begin() + session.offsets[s]);
+        std::copy(segments[s].b, segments[s].b + segments[s].size, session.b.begin() + session.offsets[s]);
+    }
+
+    /**
+     * Allocate device memory and transfer the inputs.
+     * */
+
+    cl::Buffer aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, N * sizeof(int));
+    cl::Buffer bBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, N * sizeof(int));
+    cl::Buffer cBuf = acquireBuffer(CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, N * sizeof(int));
+    cl::Buffer offsetsBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, session.offsets.size() * sizeof(int));
+    queue.enqueueWriteBuffer(aBuf, CL_FALSE, 0, N * sizeof(int), session.a.data(), NULL, profileEvent(HOST_TO_DEVICE, "write a (batch)"));
+    queue.enqueueWriteBuffer(bBuf, CL_FALSE, 0, N * sizeof(int), session.b.data(), NULL, profileEvent(HOST_TO_DEVICE, "write b (batch)"));
+    queue.enqueueWriteBuffer(offsetsBuf, CL_FALSE, 0, session.offsets.size() * sizeof(int), session.offsets.data(), NULL, profileEvent(HOST_TO_DEVICE, "write offsets"));
+
+    /**
+     * Execute the kernel function, with one work-group per segment,
+     * and collect its result.
+     * */
+
+    session.kernel.setArg(0, aBuf);
+    session.kernel.setArg(1, bBuf);
+    session.kernel.setArg(2, cBuf);
+    session.kernel.setArg(3, offsetsBuf);
+    queue.enqueueNDRangeKernel(session.kernel, cl::NullRange, cl::NDRange(segments.size() * session.local), cl::NDRange(session.local), NULL, profileEvent(KERNEL, "sumArraysSegmented"));
+    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, N * sizeof(int), session.c.data(), NULL, profileEvent(DEVICE_TO_HOST, "read c (batch)"));
+
+    releaseBuffer(aBuf);
+    releaseBuffer(bBuf);
+    releaseBuffer(cBuf);
+    releaseBuffer(offsetsBuf);
+
+    /**
+     * Unpack the output segments.
+     * */
+
+    for(size_t s = 0; s < segments.size(); s++){
+        std::copy(session.c.begin() + session.offsets[s], session.c.begin() + session.offsets[s + 1], segments[s].c);
+    }
+}
+
+/**
+ * Check if the buffers of N-dimensional arrays fit in the device: each
+ * one within the maximum allocation size, and the three of them (rounded
+ * up by the buffer pool by at most 25%) within its global memory.
+ * */
+
+bool fitsDevice(const int N){
+    cl_ulong bytes = (cl_ulong) N * sizeof(int);
+    return bytes <= device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>() && 4 * bytes <= device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
+}
+
+/**
+ * Return the vector width used by parSumArrays: the one given by
+ * --vector-width (or ARRAYS_VECTOR_WIDTH), or else the widest of the
+ * available kernels (4, 8 or 16 ints) that does not exceed the
+ * preferred integer vector width of the device (1 means scalar).
+ * */
+
+int getVectorWidth(){
+    int width = getIntOption("vector-width", "ARRAYS_VECTOR_WIDTH", 0);
+    if(width == 0){
+        width = device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT>();
+    }
+    return width >= 16 ? 16 : width >= 8 ? 8 : width >= 4 ? 4 : 1;
+}
+
+/**
+ * Check if parSumArrays should launch its items (elements or vectors)
+ * in grid-stride mode. Unless --launch (or ARRAYS_LAUNCH) forces a
+ * shape, it does so when each work-item of the grid-stride launch
+ * would loop at least STRIDE_MIN_ITERATIONS times; smaller arrays
+ * keep one work-item per item, which has no loop overhead.
+ * */
+
+bool useGridStride(const SumArraysSession& session, const int items){
+    if(session.launch == "items"){
+        return false;
+    }
+    if(session.launch == "stride"){
+        return true;
+    }
+    return (size_t) items >= STRIDE_MIN_ITERATIONS * session.strideGlobal;
+}
+
+/**
+ * Sequentially performs c = a + b over arrays of T.
+ * */
+
+template<class T>
+void seqSumArraysOf(const T* a, const T* b, T* c, const int N){
+    for(int i = 0; i < N; i++){
+        c[i] = ElementType<T>::add(a[i], b[i]);
+    }
+}
+
+/**
+ * Parallelly performs c = a + b over arrays of T, with the program of
+ * array_addition.cl built for T (once per type).
+ * */
+
+template<class T>
+void parSumArraysOf(const T* a, const T* b, T* c, const int N){
+
+    /**
+     * Get the kernel compiled for T.
+     * */
+
+    cl::Kernel& kernel = getKernel(buildProgram("array_addition.cl", ElementType<T>::options()), "sumArraysTyped");
+
+    /**
+     * Allocate device memory and transfer the inputs.
+     * */
+
+    cl::Buffer aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, N * sizeof(T));
+    cl::Buffer bBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, N * sizeof(T));
+    cl::Buffer cBuf = acquireBuffer(CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, N * sizeof(T));
+    std::string name = ElementType<T>::name();
+    queue.enqueueWriteBuffer(aBuf, CL_FALSE, 0, N * sizeof(T), a, NULL, profileEvent(HOST_TO_DEVICE, "write a (" + name + ")"));
+    queue.enqueueWriteBuffer(bBuf, CL_FALSE, 0, N * sizeof(T), b, NULL, profileEvent(HOST_TO_DEVICE, "write b (" + name + ")"));
 
     /**
      * Execute the kernel function and collect its result.
      * */
 
-    cl::CommandQueue queue(context, device);
-    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(N));
-    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, N * sizeof(int), c);
+    kernel.setArg(0, aBuf);
+    kernel.setArg(1, bBuf);
+    kernel.setArg(2, cBuf);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(N), cl::NullRange, NULL, profileEvent(KERNEL, "sumArraysTyped (" + name + ")"));
+    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, N * sizeof(T), c, NULL, profileEvent(DEVICE_TO_HOST, "read c (" + name + ")"));
+
+    releaseBuffer(aBuf);
+    releaseBuffer(bBuf);
+    releaseBuffer(cBuf);
+}
+
+/**
+ * Benchmark parSumArraysOf<T> over N elements, appending its result to
+ * results, and check it against seqSumArraysOf<T>.
+ * */
+
+template<class T>
+bool benchmarkArraysOf(const int N, const BenchmarkOptions& options, std::vector<BenchmarkResult>& results){
+    return benchmarkElementType<T>(N, N, N,
+        [&](const T* a, const T* b, T* c){ seqSumArraysOf(a, b, c, N); },
+        [&](const T* a, const T* b, T* c){ parSumArraysOf(a, b, c, N); },
+        options, 3.0 * N * sizeof(T), GIGABYTES_PER_SECOND, results);
 }
 
 /**
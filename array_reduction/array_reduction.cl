@@ -0,0 +1,145 @@
+/**
+ * Declare the element type, the reduction operation and the work-group size
+ * (a power of two, which must be the same used by the host code). The host
+ * overrides them with -D ELEMENT_TYPE, -D REDUCE_MIN or -D REDUCE_MAX (the sum
+ * is the default), -D IDENTITY and -D GROUP_SIZE.
+ */
+
+#ifndef ELEMENT_TYPE
+#define ELEMENT_TYPE int
+#endif
+
+#ifndef GROUP_SIZE
+#define GROUP_SIZE 256
+#endif
+
+#if defined(REDUCE_MIN)
+#define REDUCE(x, y) min(x, y)
+#elif defined(REDUCE_MAX)
+#define REDUCE(x, y) max(x, y)
+#else
+#define REDUCE(x, y) ((x) + (y))
+#endif
+
+#ifndef IDENTITY
+#define IDENTITY 0
+#endif
+
+#ifdef ENABLE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+/**
+ * This kernel function reduces the N elements of an array to one partial
+ * result per work-group: each work-item first reduces the elements at the
+ * stride of the whole grid in a register, and then the work-group reduces
+ * its registers as a tree in local memory. Running it again over the
+ * partial results with a single work-group yields the final result.
+ */
+
+__kernel void reduceArray(__global ELEMENT_TYPE* in,
+                          __global ELEMENT_TYPE* out,
+                          const int N){
+
+    /**
+     * Reduce the elements of this work-item in a register.
+     */
+
+    ELEMENT_TYPE acc = IDENTITY;
+    for(int i = get_global_id(0); i < N; i += get_global_size(0)){
+        acc = REDUCE(acc, in[i]);
+    }
+
+    /**
+     * Reduce the registers of the work-group in local memory.
+     */
+
+    __local ELEMENT_TYPE partial[GROUP_SIZE];
+    int localIndex = get_local_id(0);
+    partial[localIndex] = acc;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(int s = GROUP_SIZE / 2; s > 0; s >>= 1){
+        if(localIndex < s){
+            partial[localIndex] = REDUCE(partial[localIndex], partial[localIndex + s]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    /**
+     * Store the partial result of the work-group.
+     */
+
+    if(localIndex == 0){
+        out[get_group_id(0)] = partial[0];
+    }
+}
+
+/**
+ * Keep in (value, index) the greatest of two elements, or the one with the
+ * lowest index if they are equal, so that the first maximum is found.
+ */
+
+inline void argmaxStep(ELEMENT_TYPE* value, int* index, ELEMENT_TYPE otherValue, int otherIndex){
+    if(otherIndex >= 0 && (*index < 0 || otherValue > *value || (otherValue == *value && otherIndex < *index))){
+        *value = otherValue;
+        *index = otherIndex;
+    }
+}
+
+/**
+ * This kernel function finds the maximum of an array and its index, with the
+ * same two-level scheme of reduceArray. In the first pass, inIndices is not
+ * read (indexed is 0) and each element is its own index; in the final pass,
+ * the partial maxima come with the indices found by the first one. An index
+ * of -1 marks an empty partial result.
+ */
+
+__kernel void argmaxArray(__global ELEMENT_TYPE* in,
+                          __global int* inIndices,
+                          __global ELEMENT_TYPE* outValues,
+                          __global int* outIndices,
+                          const int N,
+                          const int indexed){
+
+    /**
+     * Find the maximum of the elements of this work-item in registers.
+     */
+
+    ELEMENT_TYPE value = 0;
+    int index = -1;
+    for(int i = get_global_id(0); i < N; i += get_global_size(0)){
+        argmaxStep(&value, &index, in[i], indexed ? inIndices[i] : i);
+    }
+
+    /**
+     * Find the maximum of the registers of the work-group in local memory.
+     */
+
+    __local ELEMENT_TYPE values[GROUP_SIZE];
+    __local int indices[GROUP_SIZE];
+    int localIndex = get_local_id(0);
+    values[localIndex] = value;
+    indices[localIndex] = index;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(int s = GROUP_SIZE / 2; s > 0; s >>= 1){
+        if(localIndex < s){
+            ELEMENT_TYPE v = values[localIndex];
+            int j = indices[localIndex];
+            argmaxStep(&v, &j, values[localIndex + s], indices[localIndex + s]);
+            values[localIndex] = v;
+            indices[localIndex] = j;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    /**
+     * Store the partial result of the work-group.
+     */
+
+    if(localIndex == 0){
+        outValues[get_group_id(0)] = values[0];
+        outIndices[get_group_id(0)] = indices[0];
+    }
+}
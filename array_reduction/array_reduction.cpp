@@ -0,0 +1,391 @@
+#include <CL/cl.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../common/benchmark.hpp"
+#include "../common/buffer_pool.hpp"
+#include "../common/element_type.hpp"
+#include "../common/options.hpp"
+#include "../common/profiler.hpp"
+#include "../common/report.hpp"
+#include "../common/runtime.hpp"
+
+// =================================================================
+// ------------------------ Reduction Types ------------------------
+// =================================================================
+
+/**
+ * Operations performed by parReduce.
+ * */
+
+enum ReduceOperation {
+    REDUCE_SUM,     // The sum of the elements.
+    REDUCE_MIN,     // The smallest element.
+    REDUCE_MAX      // The greatest element.
+};
+
+/**
+ * Identity of each operation for the element types reduced by parReduce
+ * (as OpenCL C source), which sets IDENTITY in array_reduction.cl.
+ * */
+
+template<class T> const char* getIdentity(ReduceOperation op);
+
+template<> const char* getIdentity<int>(ReduceOperation op){
+    return op == REDUCE_MIN ? "INT_MAX" : op == REDUCE_MAX ? "INT_MIN" : "0";
+}
+
+template<> const char* getIdentity<float>(ReduceOperation op){
+    return op == REDUCE_MIN ? "INFINITY" : op == REDUCE_MAX ? "-INFINITY" : "0.0f";
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+const char* getOperationName(ReduceOperation op);           // Return the name of a reduction operation.
+size_t getGroupSize();                                      // Return the work-group size of the reduction kernels.
+size_t getGroupCount(const int N);                          // Return the number of work-groups of the first pass over N elements.
+template<class T>
+std::string getReduceOptions(ReduceOperation op);           // Return the build options of the reduction kernels for T and op.
+template<class T>
+T seqReduce(ReduceOperation op, const T* a, const int N);    // Sequentially reduces the N-dimensional array a.
+template<class T>
+int seqArgmax(const T* a, const int N);                     // Sequentially finds the index of the first maximum of a.
+template<class T>
+T parReduce(ReduceOperation op, const T* a, const int N);    // Parallelly reduces the N-dimensional array a.
+template<class T>
+int parArgmax(const T* a, const int N);                     // Parallelly finds the index of the first maximum of a.
+template<class T>
+bool benchmarkReductions(const int N,
+                         const BenchmarkOptions& options,
+                         std::vector<BenchmarkResult>& results); // Benchmark every reduction of N elements of T.
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main(int argc, char** argv){
+
+    /**
+     * Read the benchmark options.
+     * */
+
+    parseOptions(argc, argv);
+    BenchmarkOptions options = getBenchmarkOptions(10);
+
+    /**
+     * Prepare the array sizes, from cache-resident to memory-bound.
+     * */
+
+    const int SIZES[] = {1 << 16, 1 << 20, 1 << 24};
+    const int SIZES_COUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+    beginReport("array_reduction");
+    std::string sizes;
+    for(int i = 0; i < SIZES_COUNT; i++){
+        sizes += (i > 0 ? "," : "") + std::to_string(SIZES[i]);
+    }
+    addReportParameter("N", sizes);
+
+    /**
+     * Initialize OpenCL device.
+     * */
+
+    initializeDevice("array_reduction.cl");
+    addReportParameter("local_size", getGroupSize());
+
+    /**
+     * Sequentially and parallelly reduce arrays of each type and size
+     * (the results are stored in sequential and parallel pairs).
+     * */
+
+    std::vector<BenchmarkResult> results;
+    bool equal = true;
+    for(int i = 0; i < SIZES_COUNT; i++){
+        equal = benchmarkReductions<int>(SIZES[i], options, results) && equal;
+        equal = benchmarkReductions<float>(SIZES[i], options, results) && equal;
+    }
+
+    /**
+     * Print results.
+     * */
+
+    std::cout << "Status: " << (equal ? "SUCCESS!" : "FAILED!") << std::endl;
+    std::cout << "Execution time: " << std::endl;
+    for(size_t i = 0; i + 1 < results.size(); i += 2){
+        printBenchmark(results[i]);
+        printBenchmark(results[i + 1]);
+        std::cout << "Performance gain: " << (100 * (results[i].medianMs - results[i + 1].medianMs) / results[i + 1].medianMs) << "\%\n";
+    }
+    printBufferPoolStats();
+    printProfile();
+
+    /**
+     * Write the structured record of this run, if requested.
+     * */
+
+    for(size_t i = 0; i < results.size(); i++){
+        addReportBenchmark(results[i]);
+    }
+    writeReport(equal);
+
+    /**
+     * Release OpenCL objects.
+     * */
+
+    releaseDevice();
+    return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the name of a reduction operation.
+ * */
+
+const char* getOperationName(ReduceOperation op){
+    return op == REDUCE_MIN ? "min" : op == REDUCE_MAX ? "max" : "sum";
+}
+
+/**
+ * Return the work-group size of the reduction kernels: the greatest power
+ * of two up to 256 that the device supports (the tree reduction in local
+ * memory halves the work-group at each step).
+ * */
+
+size_t getGroupSize(){
+    size_t maxSize = std::min<size_t>(256, device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>());
+    size_t groupSize = 1;
+    while(groupSize * 2 <= maxSize){
+        groupSize *= 2;
+    }
+    return groupSize;
+}
+
+/**
+ * Return the number of work-groups of the first pass over N elements:
+ * enough to fill the device (four per compute unit), but never more than
+ * one work-group can reduce in the final pass.
+ * */
+
+size_t getGroupCount(const int N){
+    size_t groupSize = getGroupSize();
+    size_t groups = std::min<size_t>(4 * device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>(), (N + groupSize - 1) / groupSize);
+    return std::max<size_t>(1, std::min(groups, groupSize));
+}
+
+/**
+ * Return the build options of the reduction kernels for T and op.
+ * */
+
+template<class T>
+std::string getReduceOptions(ReduceOperation op){
+    std::string options = ElementType<T>::options() + " -D GROUP_SIZE=" + std::to_string(getGroupSize());
+    options += std::string(" -D IDENTITY=") + getIdentity<T>(op);
+    if(op == REDUCE_MIN){
+        options += " -D REDUCE_MIN";
+    }
+    else if(op == REDUCE_MAX){
+        options += " -D REDUCE_MAX";
+    }
+    return options;
+}
+
+/**
+ * Sequentially reduces the N-dimensional array a.
+ * */
+
+template<class T>
+T seqReduce(ReduceOperation op, const T* a, const int N){
+    if(op == REDUCE_MIN){
+        return *std::min_element(a, a + N);
+    }
+    if(op == REDUCE_MAX){
+        return *std::max_element(a, a + N);
+    }
+    T sum = 0;
+    for(int i = 0; i < N; i++){
+        sum += a[i];
+    }
+    return sum;
+}
+
+/**
+ * Sequentially finds the index of the first maximum of the N-dimensional array a.
+ * */
+
+template<class T>
+int seqArgmax(const T* a, const int N){
+    return std::max_element(a, a + N) - a;
+}
+
+/**
+ * Parallelly reduces the N-dimensional array a in two passes of the
+ * reduceArray kernel: the first one reduces the array to one partial
+ * result per work-group, and the second one reduces those with a
+ * single work-group.
+ * */
+
+template<class T>
+T parReduce(ReduceOperation op, const T* a, const int N){
+
+    /**
+     * Get the kernel compiled for T and op.
+     * */
+
+    cl::Kernel& kernel = getKernel(buildProgram("array_reduction.cl", getReduceOptions<T>(op)), "reduceArray");
+    const size_t GROUP_SIZE = getGroupSize();
+    const int GROUPS = getGroupCount(N);
+    const std::string LABEL = std::string("reduceArray (") + getOperationName(op) + ", " + ElementType<T>::name() + ")";
+
+    /**
+     * Allocate device memory and transfer the input.
+     * */
+
+    cl::Buffer aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, N * sizeof(T));
+    cl::Buffer partialBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, GROUPS * sizeof(T));
+    cl::Buffer resultBuf = acquireBuffer(CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, sizeof(T));
+    queue.enqueueWriteBuffer(aBuf, CL_FALSE, 0, N * sizeof(T), a, NULL, profileEvent(HOST_TO_DEVICE, "write a"));
+
+    /**
+     * Reduce the array to one partial result per work-group, and
+     * those to the final result. The kernel arguments are captured
+     * when each pass is enqueued.
+     * */
+
+    kernel.setArg(0, aBuf);
+    kernel.setArg(1, partialBuf);
+    kernel.setArg(2, N);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(GROUPS * GROUP_SIZE), cl::NDRange(GROUP_SIZE), NULL, profileEvent(KERNEL, LABEL + " first pass"));
+
+    kernel.setArg(0, partialBuf);
+    kernel.setArg(1, resultBuf);
+    kernel.setArg(2, GROUPS);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(GROUP_SIZE), cl::NDRange(GROUP_SIZE), NULL, profileEvent(KERNEL, LABEL + " final pass"));
+
+    T result;
+    queue.enqueueReadBuffer(resultBuf, CL_TRUE, 0, sizeof(T), &result, NULL, profileEvent(DEVICE_TO_HOST, "read result"));
+
+    releaseBuffer(aBuf);
+    releaseBuffer(partialBuf);
+    releaseBuffer(resultBuf);
+    return result;
+}
+
+/**
+ * Parallelly finds the index of the first maximum of the N-dimensional
+ * array a, with the same two passes of parReduce.
+ * */
+
+template<class T>
+int parArgmax(const T* a, const int N){
+
+    /**
+     * Get the kernel compiled for T.
+     * */
+
+    cl::Kernel& kernel = getKernel(buildProgram("array_reduction.cl", getReduceOptions<T>(REDUCE_MAX)), "argmaxArray");
+    const size_t GROUP_SIZE = getGroupSize();
+    const int GROUPS = getGroupCount(N);
+    const std::string LABEL = std::string("argmaxArray (") + ElementType<T>::name() + ")";
+
+    /**
+     * Allocate device memory and transfer the input.
+     * */
+
+    cl::Buffer aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, N * sizeof(T));
+    cl::Buffer partialValuesBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, GROUPS * sizeof(T));
+    cl::Buffer partialIndicesBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, GROUPS * sizeof(int));
+    cl::Buffer valueBuf = acquireBuffer(CL_MEM_WRITE_ONLY | CL_MEM_HOST_NO_ACCESS, sizeof(T));
+    cl::Buffer indexBuf = acquireBuffer(CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, sizeof(int));
+    queue.enqueueWriteBuffer(aBuf, CL_FALSE, 0, N * sizeof(T), a, NULL, profileEvent(HOST_TO_DEVICE, "write a"));
+
+    /**
+     * Find the maximum of each work-group (the input indices are not
+     * read by the first pass), and the maximum of those.
+     * */
+
+    kernel.setArg(0, aBuf);
+    kernel.setArg(1, indexBuf);
+    kernel.setArg(2, partialValuesBuf);
+    kernel.setArg(3, partialIndicesBuf);
+    kernel.setArg(4, N);
+    kernel.setArg(5, 0);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(GROUPS * GROUP_SIZE), cl::NDRange(GROUP_SIZE), NULL, profileEvent(KERNEL, LABEL + " first pass"));
+
+    kernel.setArg(0, partialValuesBuf);
+    kernel.setArg(1, partialIndicesBuf);
+    kernel.setArg(2, valueBuf);
+    kernel.setArg(3, indexBuf);
+    kernel.setArg(4, GROUPS);
+    kernel.setArg(5, 1);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(GROUP_SIZE), cl::NDRange(GROUP_SIZE), NULL, profileEvent(KERNEL, LABEL + " final pass"));
+
+    int index;
+    queue.enqueueReadBuffer(indexBuf, CL_TRUE, 0, sizeof(int), &index, NULL, profileEvent(DEVICE_TO_HOST, "read index"));
+
+    releaseBuffer(aBuf);
+    releaseBuffer(partialValuesBuf);
+    releaseBuffer(partialIndicesBuf);
+    releaseBuffer(valueBuf);
+    releaseBuffer(indexBuf);
+    return index;
+}
+
+/**
+ * Benchmark the sequential and parallel sum, min, max and argmax of N
+ * elements of T, appending their results (in sequential and parallel
+ * pairs) to results, and check if they agree.
+ * */
+
+template<class T>
+bool benchmarkReductions(const int N, const BenchmarkOptions& options, std::vector<BenchmarkResult>& results){
+
+    /**
+     * Prepare an input with repeated maxima, so that argmax must
+     * return the first one.
+     * */
+
+    std::vector<T> a(N);
+    for(int i = 0; i < N; i++){
+        a[i] = (T) (((i * 7919LL) % 1000) - 500) / (T) 4;
+    }
+    const double BYTES = (double) N * sizeof(T);
+    const std::string SUFFIX = std::string(" (") + ElementType<T>::name() + ", N=" + std::to_string(N) + ")";
+
+    /**
+     * Benchmark every reduction operation.
+     * */
+
+    bool equal = true;
+    const ReduceOperation OPERATIONS[] = {REDUCE_SUM, REDUCE_MIN, REDUCE_MAX};
+    for(int i = 0; i < 3; i++){
+        ReduceOperation op = OPERATIONS[i];
+        T rs, rp;
+        results.push_back(runBenchmark(std::string("Sequential ") + getOperationName(op) + SUFFIX, [&]{
+            rs = seqReduce(op, a.data(), N);
+        }, options, BYTES, GIGABYTES_PER_SECOND));
+        results.push_back(runBenchmark(std::string("Parallel ") + getOperationName(op) + SUFFIX, [&]{
+            rp = parReduce(op, a.data(), N);
+        }, options, BYTES, GIGABYTES_PER_SECOND));
+        equal = checkCloseness(&rs, &rp, 1) && equal;
+    }
+
+    /**
+     * Benchmark the argmax.
+     * */
+
+    int is, ip;
+    results.push_back(runBenchmark("Sequential argmax" + SUFFIX, [&]{
+        is = seqArgmax(a.data(), N);
+    }, options, BYTES, GIGABYTES_PER_SECOND));
+    results.push_back(runBenchmark("Parallel argmax" + SUFFIX, [&]{
+        ip = parArgmax(a.data(), N);
+    }, options, BYTES, GIGABYTES_PER_SECOND));
+    return is == ip && equal;
+}
@@ -1,22 +1,83 @@
 /**
- * This kernel function efficiently multiplies two matrices a[M,K] and b[K,N] 
- * by caching submatrices from those input matrices in the device local memory.
+ * Declare the size of each submatrix (it must be the same work-group 
+ * size used by the host code, which may override it with -D SUB_SIZE).
  */
 
-__kernel void multiplyMatricesWithCache(__global int* a,
-                                    __global int* b,
-                                    __global int* c,
-                                    const int M,
-                                    const int N, 
-                                    const int K){
+#ifndef SUB_SIZE
+#define SUB_SIZE 16
+#endif
 
-    /**
-     * Declare the size of each submatrix (it must be 
-     * the same work-group size declared in the host code).
-     */
+/**
+ * Declare the element type (int by default), which the host overrides with
+ * -D ELEMENT_TYPE (and -D ENABLE_FP64 for double). Half matrices (built with
+ * HALF_STORAGE, or ELEMENT_TYPE=half and ENABLE_FP16 on devices with
+ * cl_khr_fp16) are only stored as half: they are read and written with
+ * vload_half and vstore_half, and their products are summed as float.
+ */
+
+#ifdef ENABLE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#if defined(HALF_STORAGE) || defined(ENABLE_FP16)
+#define STORAGE_TYPE half
+#define ACCUMULATOR_TYPE float
+#define LOAD(p, i) vload_half((i), (p))
+#define STORE(p, i, v) vstore_half((v), (i), (p))
+#else
+#ifndef ELEMENT_TYPE
+#define ELEMENT_TYPE int
+#endif
+#define STORAGE_TYPE ELEMENT_TYPE
+#define ACCUMULATOR_TYPE ELEMENT_TYPE
+#define LOAD(p, i) ((p)[i])
+#define STORE(p, i, v) ((p)[i] = (v))
+#endif
+
+/**
+ * Declare the dimensions of the matrices used by multiplyWithCache.
+ * They are its runtime arguments, unless the host compiles a variant for a
+ * single shape with -D M_CONST, -D N_CONST and -D K_CONST: then the number of
+ * submatrices and the edge checks are constants, and the loops over them can
+ * be fully unrolled.
+ */
+
+#ifdef M_CONST
+#define DIM_M M_CONST
+#else
+#define DIM_M M
+#endif
+
+#ifdef N_CONST
+#define DIM_N N_CONST
+#else
+#define DIM_N N
+#endif
+
+#ifdef K_CONST
+#define DIM_K K_CONST
+#else
+#define DIM_K K
+#endif
+
+/**
+ * This function efficiently multiplies two matrices a[M,K] and b[K,N] by
+ * caching submatrices from those input matrices in the local memory given by
+ * the calling kernel (aSub and bSub). The matrices may have any shape: the
+ * host rounds the global range up to whole work-groups, elements past the
+ * edges of A and B are cached as zeros, and work-items past the edges of C
+ * store nothing.
+ */
+
+inline void multiplyWithCache(__global STORAGE_TYPE* a,
+                              __global STORAGE_TYPE* b,
+                              __global STORAGE_TYPE* c,
+                              const int M,
+                              const int N,
+                              const int K,
+                              __local ACCUMULATOR_TYPE (*aSub)[SUB_SIZE],
+                              __local ACCUMULATOR_TYPE (*bSub)[SUB_SIZE]){
 
-    const int SUB_SIZE = 16;
-    
     /**
      * Get work-item identifiers.
      */
@@ -25,26 +86,18 @@ __kernel void multiplyMatricesWithCache(__global int* a,
     int rowIndex = get_local_id(1);
     int globalColIndex = get_global_id(0);
     int globalRowIndex = get_global_id(1);
-    int index = (globalRowIndex * N) + globalColIndex;
-
-    /**
-     * Create submatrices that will cache the matrices A and B in local memory.
-     */
-
-    __local int aSub[SUB_SIZE][SUB_SIZE];
-    __local int bSub[SUB_SIZE][SUB_SIZE];
 
     /**
      * Initialize accumulator register.
      */
 
-    int sum = 0;
+    ACCUMULATOR_TYPE sum = 0;
 
     /**
      * Loop over all submatrices.
      */
 
-    const int nSub = K / SUB_SIZE;
+    const int nSub = (DIM_K + SUB_SIZE - 1) / SUB_SIZE;
     for(int s = 0; s < nSub; s++){
 
         /**
@@ -53,8 +106,8 @@ __kernel void multiplyMatricesWithCache(__global int* a,
 
         const int sCol = SUB_SIZE * s + colIndex;
         const int sRow = SUB_SIZE * s + rowIndex;
-        aSub[rowIndex][colIndex] = a[globalRowIndex * K + sCol];
-        bSub[rowIndex][colIndex] = b[sRow * N + globalColIndex];
+        aSub[rowIndex][colIndex] = (globalRowIndex < DIM_M && sCol < DIM_K) ? LOAD(a, globalRowIndex * DIM_K + sCol) : 0;
+        bSub[rowIndex][colIndex] = (sRow < DIM_K && globalColIndex < DIM_N) ? LOAD(b, sRow * DIM_N + globalColIndex) : 0;
 
         /**
          * Synchronize all work-items in this work-group.
@@ -81,5 +134,206 @@ __kernel void multiplyMatricesWithCache(__global int* a,
      * Store the final result in the matrix C.
      */
 
-    c[index] = sum;
+    if(globalRowIndex < DIM_M && globalColIndex < DIM_N){
+        STORE(c, globalRowIndex * DIM_N + globalColIndex, sum);
+    }
+}
+
+/**
+ * This kernel function multiplies two matrices a[M,K] and b[K,N] with the
+ * submatrices cached by multiplyWithCache.
+ */
+
+__kernel void multiplyMatricesWithCache(__global STORAGE_TYPE* a,
+                                    __global STORAGE_TYPE* b,
+                                    __global STORAGE_TYPE* c,
+                                    const int M,
+                                    const int N, 
+                                    const int K){
+
+    /**
+     * Create submatrices that will cache the matrices A and B in local memory.
+     */
+
+    __local ACCUMULATOR_TYPE aSub[SUB_SIZE][SUB_SIZE];
+    __local ACCUMULATOR_TYPE bSub[SUB_SIZE][SUB_SIZE];
+    multiplyWithCache(a, b, c, M, N, K, aSub, bSub);
+}
+
+/**
+ * This kernel function multiplies a batch of matrices a[M,K] and b[K,N]
+ * stored at fixed strides (in elements) in the buffers a, b and c: the third
+ * dimension of the global range is the index of each product in the batch.
+ * A stride of 0 shares the same matrix with the whole batch.
+ */
+
+__kernel void multiplyMatricesStrided(__global STORAGE_TYPE* a,
+                                      __global STORAGE_TYPE* b,
+                                      __global STORAGE_TYPE* c,
+                                      const int M,
+                                      const int N,
+                                      const int K,
+                                      const int strideA,
+                                      const int strideB,
+                                      const int strideC){
+    __local ACCUMULATOR_TYPE aSub[SUB_SIZE][SUB_SIZE];
+    __local ACCUMULATOR_TYPE bSub[SUB_SIZE][SUB_SIZE];
+    size_t batch = get_global_id(2);
+    multiplyWithCache(a + batch * strideA, b + batch * strideB, c + batch * strideC, M, N, K, aSub, bSub);
+}
+
+/**
+ * This kernel function multiplies a batch of matrices a[M,K] and b[K,N]
+ * stored anywhere in the buffers a, b and c: product i reads its matrices at
+ * the offsets (in elements, 64-bit so that large batches do not overflow)
+ * offsets[3i] and offsets[3i + 1], and writes its result at offsets[3i + 2]. The third dimension of the global range is the
+ * index of each product in the batch.
+ */
+
+__kernel void multiplyMatricesIndexed(__global STORAGE_TYPE* a,
+                                      __global STORAGE_TYPE* b,
+                                      __global STORAGE_TYPE* c,
+                                      __global long* offsets,
+                                      const int M,
+                                      const int N,
+                                      const int K){
+    __local ACCUMULATOR_TYPE aSub[SUB_SIZE][SUB_SIZE];
+    __local ACCUMULATOR_TYPE bSub[SUB_SIZE][SUB_SIZE];
+    size_t batch = get_global_id(2);
+    multiplyWithCache(a + offsets[3 * batch], b + offsets[3 * batch + 1], c + offsets[3 * batch + 2], M, N, K, aSub, bSub);
+}
+
+/**
+ * Declare the shape of the register-blocked kernel below (the host overrides
+ * it with -D options): each work-group computes a TILE_M x TILE_N tile of the
+ * matrix C, caching TILE_K columns of A and rows of B at a time, and each of
+ * its work-items accumulates a WPT_M x WPT_N micro-tile of C in registers.
+ */
+
+#ifndef TILE_M
+#define TILE_M 64
+#endif
+
+#ifndef TILE_N
+#define TILE_N 64
+#endif
+
+#ifndef TILE_K
+#define TILE_K 16
+#endif
+
+#ifndef WPT_M
+#define WPT_M 4
+#endif
+
+#ifndef WPT_N
+#define WPT_N 4
+#endif
+
+#define RTS_M (TILE_M / WPT_M)
+#define RTS_N (TILE_N / WPT_N)
+
+/**
+ * This kernel function multiplies two matrices a[M,K] and b[K,N] with a
+ * micro-tile of C per work-item, so that every value loaded from local memory
+ * feeds WPT_M or WPT_N multiply-adds instead of one. The micro-tile of a
+ * work-item is strided by the number of work-items along each dimension
+ * (RTS_M, RTS_N), so that neighbouring work-items read neighbouring local
+ * memory words and store neighbouring elements of C.
+ */
+
+__kernel void multiplyMatricesBlocked(__global int* a,
+                                      __global int* b,
+                                      __global int* c,
+                                      const int M,
+                                      const int N,
+                                      const int K){
+
+    /**
+     * Get work-item identifiers and the first row and column of the tile.
+     */
+
+    int colIndex = get_local_id(0);
+    int rowIndex = get_local_id(1);
+    int localIndex = rowIndex * RTS_N + colIndex;
+    int tileRow = get_group_id(1) * TILE_M;
+    int tileCol = get_group_id(0) * TILE_N;
+
+    /**
+     * Create submatrices that will cache the matrices A and B in local
+     * memory, and the accumulators of the micro-tile in registers.
+     */
+
+    __local int aSub[TILE_M][TILE_K];
+    __local int bSub[TILE_K][TILE_N];
+
+    int acc[WPT_M][WPT_N];
+    for(int wm = 0; wm < WPT_M; wm++){
+        for(int wn = 0; wn < WPT_N; wn++){
+            acc[wm][wn] = 0;
+        }
+    }
+
+    /**
+     * Loop over all submatrices.
+     */
+
+    for(int t = 0; t < K; t += TILE_K){
+
+        /**
+         * Load submatrices into local memory, spreading their elements
+         * over every work-item of the work-group.
+         */
+
+        for(int i = localIndex; i < TILE_M * TILE_K; i += RTS_M * RTS_N){
+            int r = i / TILE_K;
+            int k = i % TILE_K;
+            aSub[r][k] = a[(tileRow + r) * K + t + k];
+        }
+        for(int i = localIndex; i < TILE_K * TILE_N; i += RTS_M * RTS_N){
+            int k = i / TILE_N;
+            int col = i % TILE_N;
+            bSub[k][col] = b[(t + k) * N + tileCol + col];
+        }
+
+        /**
+         * Synchronize all work-items in this work-group.
+         */
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        /**
+         * Accumulate the products of a column of A and a row of B into the
+         * micro-tile, keeping the values of B in registers.
+         */
+
+        for(int k = 0; k < TILE_K; k++){
+            int bReg[WPT_N];
+            for(int wn = 0; wn < WPT_N; wn++){
+                bReg[wn] = bSub[k][colIndex + wn * RTS_N];
+            }
+            for(int wm = 0; wm < WPT_M; wm++){
+                int aReg = aSub[rowIndex + wm * RTS_M][k];
+                for(int wn = 0; wn < WPT_N; wn++){
+                    acc[wm][wn] += aReg * bReg[wn];
+                }
+            }
+        }
+
+        /**
+         * Synchronize all work-items in this work-group.
+         */
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    /**
+     * Store the micro-tile in the matrix C.
+     */
+
+    for(int wm = 0; wm < WPT_M; wm++){
+        for(int wn = 0; wn < WPT_N; wn++){
+            c[(tileRow + rowIndex + wm * RTS_M) * N + tileCol + colIndex + wn * RTS_N] = acc[wm][wn];
+        }
+    }
 }
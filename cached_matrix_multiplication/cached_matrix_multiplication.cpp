@@ -1,19 +1,44 @@
 #include <CL/cl.hpp>
-#include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../common/autotuner.hpp"
+#include "../common/benchmark.hpp"
+#include "../common/buffer_pool.hpp"
+#include "../common/element_type.hpp"
+#include "../common/options.hpp"
+#include "../common/profiler.hpp"
+#include "../common/report.hpp"
+#include "../common/runtime.hpp"
 
-#include <CL/cl.hpp>
-#include <fstream>
-#include <iostream>
-#include <algorithm>
+// =================================================================
+// ------------------------- Kernel Shapes -------------------------
+// =================================================================
+
+/**
+ * Shape of the register-blocked kernel: the tile of C computed by each
+ * work-group, the depth of the submatrices it caches, and the micro-tile
+ * of C accumulated in registers by each work-item.
+ * */
+
+struct BlockedShape {
+    int tileM;      // The rows of the tile of C (TILE_M).
+    int tileN;      // The columns of the tile of C (TILE_N).
+    int tileK;      // The columns of A and rows of B cached at a time (TILE_K).
+    int wptM;       // The rows of the micro-tile of each work-item (WPT_M).
+    int wptN;       // The columns of the micro-tile of each work-item (WPT_N).
+};
 
 // =================================================================
 // ---------------------- Secondary Functions ----------------------
 // =================================================================
 
-cl::Device getDefaultDevice();        // Return the first device found in this OpenCL platform.
-void initializeDevice();              // Inicialize device and compile kernel code.
 void seqMultiplyMatrices(int* a, 
                         int* b, 
                         int* c, 
@@ -26,40 +51,104 @@ void parMultiplyMatrices(int* a,
                         const int M, 
                         const int N, 
                         const int K); // Parallelly performs the operation c[M,N] = a[M,K] * b[K,N].
+cl::Kernel& getMultiplyKernel(const int M,
+                              const int N,
+                              const int K);                 // Return the cached kernel for a shape (specialized once it is hot).
+void precompileShape(const int M,
+                     const int N,
+                     const int K);                          // Compile the specialized kernel of a shape ahead of its use.
+void buildPendingShapes();                                  // Compile the specialized kernels of the shapes that became hot.
+std::string getShapeOptions(const int M,
+                            const int N,
+                            const int K);                   // Return the build options of the specialized kernel of a shape.
+void parMultiplyMatricesBlocked(int* a,
+                                int* b,
+                                int* c,
+                                const int M,
+                                const int N,
+                                const int K,
+                                const BlockedShape& shape); // Parallelly performs c[M,N] = a[M,K] * b[K,N] with micro-tiles.
+BlockedShape getBlockedShape(const int M,
+                             const int N,
+                             const int K);                  // Choose the shape of the register-blocked kernel for a problem.
+std::string getBlockedOptions(const BlockedShape& shape);   // Return the build options that set the shape of the register-blocked kernel.
+void parMultiplyMatricesStrided(int* a,
+                                int* b,
+                                int* c,
+                                const int M,
+                                const int N,
+                                const int K,
+                                const int batch,
+                                const int strideA,
+                                const int strideB);         // Parallelly performs c[i] = a[i] * b[i] for a batch of matrices at fixed strides.
+void parMultiplyMatricesIndexed(int** a,
+                                int** b,
+                                int** c,
+                                const int M,
+                                const int N,
+                                const int K,
+                                const int batch);           // Parallelly performs c[i] = a[i] * b[i] for a batch of matrices anywhere in memory.
+cl_long packMatrix(std::map<int*, cl_long>& offsets,
+                   std::vector<int>& packed,
+                   int* matrix,
+                   const int size);                         // Append a matrix to a packed batch once, returning its offset.
+void tuneWorkGroupSize(int* a, 
+                       int* b, 
+                       int* c, 
+                       const int M, 
+                       const int N, 
+                       const int K);  // Select the fastest work-group size for this device and problem size.
 bool checkEquality(int* c1, 
                     int* c2, 
                     const int M, 
                     const int N);      // Check if the matrices c1 and c2 are equal.
+template<class T>
+void parMultiplyMatricesOf(const T* a, const T* b, T* c,
+                           const int M, const int N,
+                           const int K);            // Parallelly performs c[M,N] = a[M,K] * b[K,N] over matrices of T.
+template<class T>
+bool benchmarkMatricesOf(const int M, const int N, const int K,
+                         const BenchmarkOptions& options,
+                         std::vector<BenchmarkResult>& results); // Benchmark parMultiplyMatricesOf<T> and check its result.
 
 // =================================================================
 // ------------------------ Global Variables ------------------------
 // =================================================================
 
-cl::Program program;                // The program that will run on the device.    
-cl::Context context;                // The context which holds the device.    
-cl::Device device;                  // The device where the kernel will run.
-const size_t WG_SIZE[2] = {16, 16}; // The size of work-groups.
+size_t WG_SIZE[2] = {16, 16};       // The size of work-groups (the SUB_SIZE of the kernel).
+int SPECIALIZE_AFTER = 0;           // The uses of a shape after which it gets its own kernel variant (0 disables them).
+std::map<std::string, int> shapeUses; // The number of multiplications of each shape and work-group size.
+std::set<std::string> pendingShapes;  // The shapes that became hot and whose kernels are not compiled yet.
 
 // =================================================================
 // ------------------------- Main Function -------------------------
 // =================================================================
 
-int main(){
+int main(int argc, char** argv){
     
     /**
-     * Create auxiliary variables.
+     * Read the benchmark options.
      * */
 
-    clock_t start, end;
-    const int EXECUTIONS = 40;
+    parseOptions(argc, argv);
+    BenchmarkOptions options = getBenchmarkOptions(40);
     
     /**
      * Prepare input constants related to the dimensions of the matrices.
      * */
 
-    const int M = 1 << 4;
-    const int N = 1 << 4;
-    const int K = 1 << 12;
+    const int M = getIntOption("m", "GEMM_M", 1 << 4);
+    const int N = getIntOption("n", "GEMM_N", 1 << 4);
+    const int K = getIntOption("k", "GEMM_K", 1 << 12);
+    if(M < 1 || N < 1 || K < 1){
+        std::cerr << "Invalid matrix dimensions: M=" << M << ", N=" << N << ", K=" << K << std::endl;
+        exit(1);
+    }
+    const double FLOPS = 2.0 * M * N * K;
+    beginReport("cached_matrix_multiplication");
+    addReportParameter("M", M);
+    addReportParameter("N", N);
+    addReportParameter("K", K);
 
     /**
      * Prepare input matrices A and B.
@@ -86,126 +175,164 @@ int main(){
      * Sequentially multiply matrices.
      * */
 
-    start = clock();
-    for(int i = 0; i < EXECUTIONS; i++){
+    BenchmarkResult seqResult = runBenchmark("Sequential", [&]{
         seqMultiplyMatrices(a.data(), b.data(), cs.data(), M, N, K);
-    }
-    end = clock();
-    double seqTime = ((double) 10e3 * (end - start)) / CLOCKS_PER_SEC / EXECUTIONS;
+    }, options, FLOPS, GIGAFLOPS_PER_SECOND);
 
     /**
      * Initialize OpenCL device.
      * */
 
-    initializeDevice();
+    initializeDevice("cached_matrix_multiplication.cl");
 
     /**
-     * Parallelly multiply matrices.
+     * Select the work-group size (tuned now with --tune, or by a
+     * previous run).
      * */
 
-    start = clock();
-    for(int i = 0; i < EXECUTIONS; i++){
-        parMultiplyMatrices(a.data(), b.data(), cp.data(), M, N, K);
-    }
-    end = clock();
-    double parTime = ((double) 10e3 * (end - start)) / CLOCKS_PER_SEC / EXECUTIONS;
+    tuneWorkGroupSize(a.data(), b.data(), cp.data(), M, N, K);
+    addReportParameter("local_size", std::to_string(WG_SIZE[0]) + "x" + std::to_string(WG_SIZE[1]));
 
     /**
-     * Check if outputs are equal.
+     * Compile a variant of the kernel for the shapes that are multiplied
+     * often (the tuning above always runs the generic one). The benchmark
+     * multiplies its shape far more often, so its variant is compiled now,
+     * out of the timed repetitions.
      * */
 
-    bool equal = checkEquality(cs.data(), cp.data(), ROWS_C, COLS_C);
+    SPECIALIZE_AFTER = std::max(0, getIntOption("specialize-after", "GEMM_SPECIALIZE_AFTER", 3));
+    addReportParameter("specialize_after", SPECIALIZE_AFTER);
+    precompileShape(M, N, K);
 
     /**
-     * Print results.
+     * Parallelly multiply matrices.
      * */
 
-    std::cout << "Status: " << (equal ? "SUCCESS!" : "FAILED!") << std::endl;
-    std::cout << "Results: \n\tA[0] = " << a[0] << "\n\tB[0] = " << b[0] << "\n\tC[0] = " << cp[0] << std::endl;
-    std::cout << "Mean execution time: \n\tSequential: " << seqTime << " ms;\n\tParallel: " << parTime << " ms." << std::endl;
-    std::cout << "Performance gain: " << (100 * (seqTime - parTime) / parTime) << "\%\n";
-    return 0;
-}
+    BenchmarkResult parResult = runBenchmark("Parallel", [&]{
+        parMultiplyMatrices(a.data(), b.data(), cp.data(), M, N, K);
+    }, options, FLOPS, GIGAFLOPS_PER_SECOND);
 
-// =================================================================
-// ---------------------- Secondary Functions ----------------------
-// =================================================================
+    /**
+     * Parallelly multiply matrices with the register-blocked kernel.
+     * */
 
-/**
- * Return the first device found in this OpenCL platform.
- * */
+    BlockedShape shape = getBlockedShape(M, N, K);
+    std::string microTile = std::to_string(shape.wptM) + "x" + std::to_string(shape.wptN);
+    addReportParameter("micro_tile", microTile);
+    addReportParameter("block_tile", std::to_string(shape.tileM) + "x" + std::to_string(shape.tileN) + "x" + std::to_string(shape.tileK));
+    std::vector<int> cb(ROWS_C * COLS_C);
+    BenchmarkResult blockedResult = runBenchmark("Parallel (register-blocked " + microTile + ")", [&]{
+        parMultiplyMatricesBlocked(a.data(), b.data(), cb.data(), M, N, K, shape);
+    }, options, FLOPS, GIGAFLOPS_PER_SECOND);
 
-cl::Device getDefaultDevice(){
-    
     /**
-     * Search for all the OpenCL platforms available and check
-     * if there are any.
+     * Multiply a batch of small matrices, with a call per product and
+     * with a single launch (with the matrices at fixed strides, and
+     * through arrays of pointers).
      * */
 
-    std::vector<cl::Platform> platforms;
-    cl::Platform::get(&platforms);
-
-    if (platforms.empty()){
-        std::cerr << "No platforms found!" << std::endl;
-        exit(1);
+    const int BATCH = getIntOption("batch", "GEMM_BATCH", 512);
+    const int BATCH_DIM = getIntOption("batch-dim", "GEMM_BATCH_DIM", 24);
+    const int BATCH_SIZE = BATCH_DIM * BATCH_DIM;
+    const double BATCH_FLOPS = 2.0 * BATCH * BATCH_DIM * BATCH_DIM * BATCH_DIM;
+    addReportParameter("batch", BATCH);
+    addReportParameter("batch_dim", BATCH_DIM);
+
+    std::vector<int> ba(BATCH * BATCH_SIZE), bb(BATCH * BATCH_SIZE);
+    std::vector<int> bcs(BATCH * BATCH_SIZE), bcp(BATCH * BATCH_SIZE), bcb(BATCH * BATCH_SIZE), bci(BATCH * BATCH_SIZE);
+    std::vector<int*> aPtrs(BATCH), bPtrs(BATCH), cPtrs(BATCH);
+    for(int i = 0; i < BATCH * BATCH_SIZE; i++){
+        ba[i] = i % 7;
+        bb[i] = i % 5 - 2;
+    }
+    for(int i = 0; i < BATCH; i++){
+        seqMultiplyMatrices(&ba[i * BATCH_SIZE], &bb[i * BATCH_SIZE], &bcs[i * BATCH_SIZE], BATCH_DIM, BATCH_DIM, BATCH_DIM);
+        aPtrs[i] = &ba[i * BATCH_SIZE];
+        bPtrs[i] = &bb[i * BATCH_SIZE];
+        cPtrs[i] = &bci[i * BATCH_SIZE];
     }
 
-    /**
-     * Search for all the devices on the first platform and check if
-     * there are any available.
-     * */
+    precompileShape(BATCH_DIM, BATCH_DIM, BATCH_DIM);
+    BenchmarkResult perMatrixResult = runBenchmark("Parallel (call per matrix, batch of " + std::to_string(BATCH) + ")", [&]{
+        for(int i = 0; i < BATCH; i++){
+            parMultiplyMatrices(&ba[i * BATCH_SIZE], &bb[i * BATCH_SIZE], &bcp[i * BATCH_SIZE], BATCH_DIM, BATCH_DIM, BATCH_DIM);
+        }
+    }, options, BATCH_FLOPS, GIGAFLOPS_PER_SECOND);
 
-    auto platform = platforms.front();
-    std::vector<cl::Device> devices;
-    platform.getDevices(CL_DEVICE_TYPE_ALL, &devices);
+    BenchmarkResult stridedResult = runBenchmark("Parallel (strided batch)", [&]{
+        parMultiplyMatricesStrided(ba.data(), bb.data(), bcb.data(), BATCH_DIM, BATCH_DIM, BATCH_DIM, BATCH, BATCH_SIZE, BATCH_SIZE);
+    }, options, BATCH_FLOPS, GIGAFLOPS_PER_SECOND);
 
-    if (devices.empty()){
-        std::cerr << "No devices found!" << std::endl;
-        exit(1);
-    }
+    BenchmarkResult indexedResult = runBenchmark("Parallel (pointer-array batch)", [&]{
+        parMultiplyMatricesIndexed(aPtrs.data(), bPtrs.data(), cPtrs.data(), BATCH_DIM, BATCH_DIM, BATCH_DIM, BATCH);
+    }, options, BATCH_FLOPS, GIGAFLOPS_PER_SECOND);
 
     /**
-     * Return the first device found.
+     * Parallelly multiply matrices of the floating-point types, so that
+     * their throughputs can be compared.
      * */
 
-    return devices.front();
-}
+    std::vector<BenchmarkResult> typedResults;
+    bool typedEqual = benchmarkMatricesOf<float>(M, N, K, options, typedResults);
+    typedEqual = benchmarkMatricesOf<double>(M, N, K, options, typedResults) && typedEqual;
+    typedEqual = benchmarkMatricesOf<Half>(M, N, K, options, typedResults) && typedEqual;
 
-/**
- * Inicialize device and compile kernel code.
- * */
+    /**
+     * Check if outputs are equal.
+     * */
 
-void initializeDevice(){
+    bool equal = checkEquality(cs.data(), cp.data(), ROWS_C, COLS_C) && checkEquality(cs.data(), cb.data(), ROWS_C, COLS_C)
+              && checkEquality(bcs.data(), bcp.data(), BATCH * BATCH_DIM, BATCH_DIM) && checkEquality(bcs.data(), bcb.data(), BATCH * BATCH_DIM, BATCH_DIM)
+              && checkEquality(bcs.data(), bci.data(), BATCH * BATCH_DIM, BATCH_DIM) && typedEqual;
 
     /**
-     * Select the first available device.
+     * Print results.
      * */
 
-    device = getDefaultDevice();
-    
+    std::cout << "Status: " << (equal ? "SUCCESS!" : "FAILED!") << std::endl;
+    std::cout << "Results: \n\tA[0] = " << a[0] << "\n\tB[0] = " << b[0] << "\n\tC[0] = " << cp[0] << std::endl;
+    std::cout << "Execution time: " << std::endl;
+    printBenchmark(seqResult);
+    printBenchmark(parResult);
+    printBenchmark(blockedResult);
+    printBenchmark(perMatrixResult);
+    printBenchmark(stridedResult);
+    printBenchmark(indexedResult);
+    std::cout << "Performance gain: " << (100 * (seqResult.medianMs - parResult.medianMs) / parResult.medianMs) << "\%\n";
+    std::cout << "Batching gain: " << (100 * (perMatrixResult.medianMs - stridedResult.medianMs) / stridedResult.medianMs) << "\%\n";
+    for(size_t i = 0; i < typedResults.size(); i++){
+        printBenchmark(typedResults[i]);
+    }
+    printBufferPoolStats();
+    printProfile();
+
     /**
-     * Read OpenCL kernel file as a string.
+     * Write the structured record of this run, if requested.
      * */
 
-    std::ifstream kernel_file("cached_matrix_multiplication.cl");
-    std::string src(std::istreambuf_iterator<char>(kernel_file), (std::istreambuf_iterator<char>()));
+    addReportBenchmark(seqResult);
+    addReportBenchmark(parResult);
+    addReportBenchmark(blockedResult);
+    addReportBenchmark(perMatrixResult);
+    addReportBenchmark(stridedResult);
+    addReportBenchmark(indexedResult);
+    for(size_t i = 0; i < typedResults.size(); i++){
+        addReportBenchmark(typedResults[i]);
+    }
+    writeReport(equal);
 
     /**
-     * Compile kernel program which will run on the device.
+     * Release OpenCL objects.
      * */
 
-    cl::Program::Sources sources(1, std::make_pair(src.c_str(), src.length() + 1));
-    context = cl::Context(device);
-    program = cl::Program(context, sources);
-    
-    auto err = program.build();
-    if(err != CL_BUILD_SUCCESS){
-        std::cerr << "Error!\nBuild Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device) 
-        << "\nBuild Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
-        exit(1);
-    }
+    releaseDevice();
+    return 0;
 }
 
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
 /**
  * Sequentially performs the operation c[M,N] = a[M,K] * b[K,N].
  * */
@@ -238,15 +365,17 @@ void parMultiplyMatrices(int* a, int* b, int* c,
      * Create buffers and allocate memory on the device.
      * */
 
-    cl::Buffer aBuf(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, M * K * sizeof(int), a);
-    cl::Buffer bBuf(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, K * N * sizeof(int), b);
-    cl::Buffer cBuf(context, CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY, M * N * sizeof(int));
+    cl::Buffer aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, M * K * sizeof(int));
+    cl::Buffer bBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, K * N * sizeof(int));
+    cl::Buffer cBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY, M * N * sizeof(int));
+    queue.enqueueWriteBuffer(aBuf, CL_FALSE, 0, M * K * sizeof(int), a, NULL, profileEvent(HOST_TO_DEVICE, "write a"));
+    queue.enqueueWriteBuffer(bBuf, CL_FALSE, 0, K * N * sizeof(int), b, NULL, profileEvent(HOST_TO_DEVICE, "write b"));
 
     /**
      * Set kernel arguments.
      * */
 
-    cl::Kernel kernel(program, "multiplyMatricesWithCache");
+    cl::Kernel& kernel = getMultiplyKernel(M, N, K);
     kernel.setArg(0, aBuf);
     kernel.setArg(1, bBuf);
     kernel.setArg(2, cBuf);
@@ -254,13 +383,514 @@ void parMultiplyMatrices(int* a, int* b, int* c,
     kernel.setArg(4, sizeof(unsigned int), &N);
     kernel.setArg(5, sizeof(unsigned int), &K);
     
+    /**
+     * Execute the kernel function over whole work-groups (the kernel
+     * skips the work-items past the edges of C) and collect its result.
+     * */
+
+    cl::NDRange global((N + WG_SIZE[0] - 1) / WG_SIZE[0] * WG_SIZE[0], (M + WG_SIZE[1] - 1) / WG_SIZE[1] * WG_SIZE[1]);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NDRange(WG_SIZE[0], WG_SIZE[1]), NULL, profileEvent(KERNEL, "multiplyMatricesWithCache"));
+    buildPendingShapes();
+    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, M * N * sizeof(int), c, NULL, profileEvent(DEVICE_TO_HOST, "read c"));
+
+    /**
+     * Give the buffers back to the pool.
+     * */
+
+    releaseBuffer(aBuf);
+    releaseBuffer(bBuf);
+    releaseBuffer(cBuf);
+}
+
+/**
+ * Return the cached kernel for a shape. One-off shapes use the generic
+ * kernel of the default program; once a shape has been multiplied
+ * SPECIALIZE_AFTER times with the current work-group size, it gets a variant
+ * compiled with its dimensions as constants (-D M_CONST, N_CONST, K_CONST),
+ * which buildProgram and getKernel keep for the next calls.
+ *
+ * The variant is not compiled here: the call that makes the shape hot still
+ * gets the generic kernel and queues the shape for buildPendingShapes, so
+ * the compilation overlaps that call's kernel and the variant is used from
+ * the next call on. The hot call still waits for the compilation when it
+ * takes longer than its kernel (and on a miss of the program cache), unless
+ * the shape was given to precompileShape beforehand.
+ * */
+
+cl::Kernel& getMultiplyKernel(const int M, const int N, const int K){
+    if(SPECIALIZE_AFTER == 0){
+        return getKernel("multiplyMatricesWithCache");
+    }
+    std::string options = getShapeOptions(M, N, K);
+    int uses = ++shapeUses[options];
+    if(uses == SPECIALIZE_AFTER){
+        pendingShapes.insert(options);
+    }
+    if(uses <= SPECIALIZE_AFTER){
+        return getKernel("multiplyMatricesWithCache");
+    }
+    return getKernel(buildProgram("cached_matrix_multiplication.cl", options), "multiplyMatricesWithCache");
+}
+
+/**
+ * Compile the specialized kernels of the shapes queued by getMultiplyKernel.
+ * It is called right after a kernel is enqueued, so the queue is flushed
+ * first to let the device run it during the compilation.
+ * */
+
+void buildPendingShapes(){
+    if(pendingShapes.empty()){
+        return;
+    }
+    queue.flush();
+    for(const std::string& options : pendingShapes){
+        getKernel(buildProgram("cached_matrix_multiplication.cl", options), "multiplyMatricesWithCache");
+    }
+    pendingShapes.clear();
+}
+
+/**
+ * Compile the specialized kernel of a shape that is known to be hot (e.g.
+ * before benchmarking it), and count it as multiplied SPECIALIZE_AFTER
+ * times, so that its next multiplications use that kernel without paying
+ * for the compilation.
+ * */
+
+void precompileShape(const int M, const int N, const int K){
+    if(SPECIALIZE_AFTER == 0){
+        return;
+    }
+    std::string options = getShapeOptions(M, N, K);
+    getKernel(buildProgram("cached_matrix_multiplication.cl", options), "multiplyMatricesWithCache");
+    shapeUses[options] = std::max(shapeUses[options], SPECIALIZE_AFTER);
+}
+
+/**
+ * Return the build options of the specialized kernel of a shape, with
+ * the current work-group size.
+ * */
+
+std::string getShapeOptions(const int M, const int N, const int K){
+    return getTileOptions(WG_SIZE[0]) + " -D M_CONST=" + std::to_string(M) +
+           " -D N_CONST=" + std::to_string(N) + " -D K_CONST=" + std::to_string(K);
+}
+
+/**
+ * Parallelly performs the operation c[i] = a[i] * b[i] for a batch of
+ * matrices a[M,K] and b[K,N], with a single launch of the cached kernel.
+ * The matrices of a and b start every strideA and strideB elements (a
+ * stride of 0 shares one matrix with the whole batch), and the results
+ * are stored one after another in c.
+ * */
+
+void parMultiplyMatricesStrided(int* a, int* b, int* c,
+                                const int M,
+                                const int N,
+                                const int K,
+                                const int batch,
+                                const int strideA,
+                                const int strideB){
+    if(batch <= 0){
+        return;
+    }
+
+    /**
+     * Create buffers and allocate memory on the device.
+     * */
+
+    const size_t A_SIZE = (size_t) (batch - 1) * strideA + (size_t) M * K;
+    const size_t B_SIZE = (size_t) (batch - 1) * strideB + (size_t) K * N;
+    const size_t C_SIZE = (size_t) batch * M * N;
+    cl::Buffer aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, A_SIZE * sizeof(int));
+    cl::Buffer bBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, B_SIZE * sizeof(int));
+    cl::Buffer cBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY, C_SIZE * sizeof(int));
+    queue.enqueueWriteBuffer(aBuf, CL_FALSE, 0, A_SIZE * sizeof(int), a, NULL, profileEvent(HOST_TO_DEVICE, "write a (batch)"));
+    queue.enqueueWriteBuffer(bBuf, CL_FALSE, 0, B_SIZE * sizeof(int), b, NULL, profileEvent(HOST_TO_DEVICE, "write b (batch)"));
+
+    /**
+     * Set kernel arguments.
+     * */
+
+    const int strideC = M * N;
+    cl::Kernel& kernel = getKernel("multiplyMatricesStrided");
+    kernel.setArg(0, aBuf);
+    kernel.setArg(1, bBuf);
+    kernel.setArg(2, cBuf);
+    kernel.setArg(3, M);
+    kernel.setArg(4, N);
+    kernel.setArg(5, K);
+    kernel.setArg(6, strideA);
+    kernel.setArg(7, strideB);
+    kernel.setArg(8, strideC);
+
+    /**
+     * Execute the kernel function, with the batch in the third dimension,
+     * and collect its result.
+     * */
+
+    cl::NDRange global((N + WG_SIZE[0] - 1) / WG_SIZE[0] * WG_SIZE[0], (M + WG_SIZE[1] - 1) / WG_SIZE[1] * WG_SIZE[1], batch);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NDRange(WG_SIZE[0], WG_SIZE[1], 1), NULL, profileEvent(KERNEL, "multiplyMatricesStrided"));
+    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, C_SIZE * sizeof(int), c, NULL, profileEvent(DEVICE_TO_HOST, "read c (batch)"));
+
+    /**
+     * Give the buffers back to the pool.
+     * */
+
+    releaseBuffer(aBuf);
+    releaseBuffer(bBuf);
+    releaseBuffer(cBuf);
+}
+
+/**
+ * Parallelly performs the operation c[i] = a[i] * b[i] for a batch of
+ * matrices a[M,K] and b[K,N] anywhere in host memory, with a single launch
+ * of the cached kernel. OpenCL 1.2 kernels cannot follow host pointers, so
+ * the matrices are packed into one buffer per operand (each distinct input
+ * matrix once, so shared ones are transferred once) and the kernel gets a
+ * table of their offsets. The results must not overlap.
+ * */
+
+void parMultiplyMatricesIndexed(int** a, int** b, int** c,
+                                const int M,
+                                const int N,
+                                const int K,
+                                const int batch){
+    if(batch <= 0){
+        return;
+    }
+
+    /**
+     * Pack the matrices and the table of their offsets.
+     * */
+
+    std::map<int*, cl_long> aOffsets, bOffsets;
+    std::vector<int> aPacked, bPacked;
+    std::vector<cl_long> offsets(3 * (size_t) batch);
+    for(int i = 0; i < batch; i++){
+        offsets[3 * i] = packMatrix(aOffsets, aPacked, a[i], M * K);
+        offsets[3 * i + 1] = packMatrix(bOffsets, bPacked, b[i], K * N);
+        offsets[3 * i + 2] = (cl_long) i * M * N;
+    }
+
+    /**
+     * Create buffers and allocate memory on the device.
+     * */
+
+    const size_t C_SIZE = (size_t) batch * M * N;
+    cl::Buffer aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, aPacked.size() * sizeof(int));
+    cl::Buffer bBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, bPacked.size() * sizeof(int));
+    cl::Buffer cBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY, C_SIZE * sizeof(int));
+    cl::Buffer offsetsBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, offsets.size() * sizeof(cl_long));
+    queue.enqueueWriteBuffer(aBuf, CL_FALSE, 0, aPacked.size() * sizeof(int), aPacked.data(), NULL, profileEvent(HOST_TO_DEVICE, "write a (batch)"));
+    queue.enqueueWriteBuffer(bBuf, CL_FALSE, 0, bPacked.size() * sizeof(int), bPacked.data(), NULL, profileEvent(HOST_TO_DEVICE, "write b (batch)"));
+    queue.enqueueWriteBuffer(offsetsBuf, CL_FALSE, 0, offsets.size() * sizeof(cl_long), offsets.data(), NULL, profileEvent(HOST_TO_DEVICE, "write offsets"));
+
+    /**
+     * Set kernel arguments.
+     * */
+
+    cl::Kernel& kernel = getKernel("multiplyMatricesIndexed");
+    kernel.setArg(0, aBuf);
+    kernel.setArg(1, bBuf);
+    kernel.setArg(2, cBuf);
+    kernel.setArg(3, offsetsBuf);
+    kernel.setArg(4, M);
+    kernel.setArg(5, N);
+    kernel.setArg(6, K);
+
+    /**
+     * Execute the kernel function, with the batch in the third dimension,
+     * and scatter its results to their matrices.
+     * */
+
+    std::vector<int> cPacked(C_SIZE);
+    cl::NDRange global((N + WG_SIZE[0] - 1) / WG_SIZE[0] * WG_SIZE[0], (M + WG_SIZE[1] - 1) / WG_SIZE[1] * WG_SIZE[1], batch);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NDRange(WG_SIZE[0], WG_SIZE[1], 1), NULL, profileEvent(KERNEL, "multiplyMatricesIndexed"));
+    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, C_SIZE * sizeof(int), cPacked.data(), NULL, profileEvent(DEVICE_TO_HOST, "read c (batch)"));
+    for(int i = 0; i < batch; i++){
+        std::copy(cPacked.begin() + offsets[3 * i + 2], cPacked.begin() + offsets[3 * i + 2] + M * N, c[i]);
+    }
+
+    /**
+     * Give the buffers back to the pool.
+     * */
+
+    releaseBuffer(aBuf);
+    releaseBuffer(bBuf);
+    releaseBuffer(cBuf);
+    releaseBuffer(offsetsBuf);
+}
+
+/**
+ * Append a matrix of the given size to a packed batch, unless it is
+ * already there, and return its offset (in elements) in the batch.
+ * */
+
+cl_long packMatrix(std::map<int*, cl_long>& offsets, std::vector<int>& packed, int* matrix, const int size){
+    std::map<int*, cl_long>::iterator found = offsets.find(matrix);
+    if(found != offsets.end()){
+        return found->second;
+    }
+    cl_long offset = packed.size();
+    offsets[matrix] = offset;
+    packed.insert(packed.end(), matrix, matrix + size);
+    return offset;
+}
+
+/**
+ * Parallelly performs the operation c[M,N] = a[M,K] * b[K,N] with the
+ * register-blocked kernel, compiled for the given shape.
+ * */
+
+void parMultiplyMatricesBlocked(int* a, int* b, int* c,
+                                const int M,
+                                const int N,
+                                const int K,
+                                const BlockedShape& shape){
+
+    /**
+     * Create buffers and allocate memory on the device.
+     * */
+
+    cl::Buffer aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, M * K * sizeof(int));
+    cl::Buffer bBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, K * N * sizeof(int));
+    cl::Buffer cBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY, M * N * sizeof(int));
+    queue.enqueueWriteBuffer(aBuf, CL_FALSE, 0, M * K * sizeof(int), a, NULL, profileEvent(HOST_TO_DEVICE, "write a"));
+    queue.enqueueWriteBuffer(bBuf, CL_FALSE, 0, K * N * sizeof(int), b, NULL, profileEvent(HOST_TO_DEVICE, "write b"));
+
+    /**
+     * Set kernel arguments.
+     * */
+
+    cl::Kernel& kernel = getKernel(buildProgram("cached_matrix_multiplication.cl", getBlockedOptions(shape)), "multiplyMatricesBlocked");
+    kernel.setArg(0, aBuf);
+    kernel.setArg(1, bBuf);
+    kernel.setArg(2, cBuf);
+    kernel.setArg(3, M);
+    kernel.setArg(4, N);
+    kernel.setArg(5, K);
+
+    /**
+     * Execute the kernel function, with a work-item per micro-tile,
+     * and collect its result.
+     * */
+
+    cl::NDRange global(N / shape.wptN, M / shape.wptM);
+    cl::NDRange local(shape.tileN / shape.wptN, shape.tileM / shape.wptM);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, profileEvent(KERNEL, "multiplyMatricesBlocked"));
+    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, M * N * sizeof(int), c, NULL, profileEvent(DEVICE_TO_HOST, "read c"));
+
+    /**
+     * Give the buffers back to the pool.
+     * */
+
+    releaseBuffer(aBuf);
+    releaseBuffer(bBuf);
+    releaseBuffer(cBuf);
+}
+
+/**
+ * Choose the shape of the register-blocked kernel for a problem. The
+ * micro-tile is given by --micro-tile=RxC (or GEMM_MICRO_TILE, 4x4 by
+ * default); the tile of each work-group aims at 16x16 work-items, as many
+ * as the device allows. Every size is halved until it divides the
+ * matrices, since the kernel does not handle partial tiles. The registers
+ * of large micro-tiles can lower the work-group size of the compiled
+ * kernel below the device limit, so the tile is halved again until the
+ * compiled kernel accepts it.
+ * */
+
+BlockedShape getBlockedShape(const int M, const int N, const int K){
+    BlockedShape shape;
+    std::string microTile = getOption("micro-tile", "GEMM_MICRO_TILE", "4x4");
+    if(sscanf(microTile.c_str(), "%dx%d", &shape.wptM, &shape.wptN) != 2 || shape.wptM < 1 || shape.wptN < 1){
+        std::cerr << "Invalid micro-tile: " << microTile << " (expected RxC, e.g. 4x4)" << std::endl;
+        exit(1);
+    }
+
+    /**
+     * Fit the micro-tile to the matrices.
+     * */
+
+    while(M % shape.wptM != 0){
+        shape.wptM /= 2;
+    }
+    while(N % shape.wptN != 0){
+        shape.wptN /= 2;
+    }
+
+    int rowItems = 16;
+    int colItems = 16;
+    size_t maxItems = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+    const cl_ulong LOCAL_MEMORY = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+    while(true){
+
+        /**
+         * Fit the work-items of the tile to the work-group limit and
+         * the matrices.
+         * */
+
+        while((size_t) (rowItems * colItems) > maxItems){
+            if(rowItems >= colItems){
+                rowItems /= 2;
+            } else{
+                colItems /= 2;
+            }
+        }
+        while(M % (rowItems * shape.wptM) != 0){
+            rowItems /= 2;
+        }
+        while(N % (colItems * shape.wptN) != 0){
+            colItems /= 2;
+        }
+        shape.tileM = rowItems * shape.wptM;
+        shape.tileN = colItems * shape.wptN;
+
+        /**
+         * Fit the depth of the cached submatrices to the matrices and to
+         * the local memory of the device (a depth of 1 always divides K).
+         * */
+
+        shape.tileK = 16;
+        while(shape.tileK > 1 && (K % shape.tileK != 0 || (cl_ulong) (shape.tileM + shape.tileN) * shape.tileK * sizeof(int) > LOCAL_MEMORY)){
+            shape.tileK /= 2;
+        }
+        if((cl_ulong) (shape.tileM + shape.tileN) * shape.tileK * sizeof(int) > LOCAL_MEMORY){
+            std::cerr << "The register-blocked kernel does not fit the local memory of the device with a " << microTile << " micro-tile." << std::endl;
+            exit(1);
+        }
+
+        /**
+         * Check the limits of the compiled kernel.
+         * */
+
+        cl::Kernel& kernel = getKernel(buildProgram("cached_matrix_multiplication.cl", getBlockedOptions(shape)), "multiplyMatricesBlocked");
+        size_t kernelItems = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+        cl_ulong kernelMemory = kernel.getWorkGroupInfo<CL_KERNEL_LOCAL_MEM_SIZE>(device);
+        size_t groupItems = rowItems * colItems;
+        if(groupItems <= kernelItems && kernelMemory <= LOCAL_MEMORY){
+            return shape;
+        }
+        if(groupItems == 1){
+            std::cerr << "The device cannot run the register-blocked kernel with a " << microTile << " micro-tile." << std::endl;
+            exit(1);
+        }
+        maxItems = std::min(groupItems / 2, std::max<size_t>(kernelItems, 1));
+    }
+}
+
+/**
+ * Return the build options that set the shape of the register-blocked kernel.
+ * */
+
+std::string getBlockedOptions(const BlockedShape& shape){
+    return "-D TILE_M=" + std::to_string(shape.tileM) + " -D TILE_N=" + std::to_string(shape.tileN) +
+           " -D TILE_K=" + std::to_string(shape.tileK) + " -D WPT_M=" + std::to_string(shape.wptM) +
+           " -D WPT_N=" + std::to_string(shape.wptN);
+}
+
+/**
+ * Select the fastest work-group size for this device and problem size.
+ * */
+
+void tuneWorkGroupSize(int* a, int* b, int* c, 
+                       const int M, 
+                       const int N,
+                       const int K){
+
+    /**
+     * Keep the square work-groups that the device can run, given the
+     * two int submatrices cached per work-item (partial tiles at the
+     * edges of the matrices are padded by the kernel).
+     * */
+
+    std::vector<int> tiles = {4, 8, 16, 32};
+    std::vector<int> candidates = getTileCandidates("cached_matrix_multiplication.cl", "multiplyMatricesWithCache", tiles, 2 * sizeof(int));
+
+    /**
+     * Time each candidate, compiled with it as SUB_SIZE.
+     * */
+
+    BenchmarkOptions tuning;
+    tuning.warmup = 1;
+    tuning.repetitions = 5;
+    std::string bucket = "M=" + getSizeBucket(M) + ",N=" + getSizeBucket(N) + ",K=" + getSizeBucket(K);
+    int tile = autotune("multiplyMatricesWithCache", bucket, candidates, 16, [&](int candidate){
+        WG_SIZE[0] = WG_SIZE[1] = candidate;
+        program = buildProgram("cached_matrix_multiplication.cl", getTileOptions(candidate));
+        return runBenchmark("Tuning", [&]{ parMultiplyMatrices(a, b, c, M, N, K); }, tuning).medianMs;
+    });
+
+    /**
+     * Use the selected work-group size and discard the tuning profile.
+     * */
+
+    WG_SIZE[0] = WG_SIZE[1] = tile;
+    program = buildProgram("cached_matrix_multiplication.cl", getTileOptions(tile));
+    resetProfile();
+}
+
+/**
+ * Parallelly performs the operation c[M,N] = a[M,K] * b[K,N] over
+ * matrices of T, with the program of cached_matrix_multiplication.cl built for T (once per type).
+ * */
+
+template<class T>
+void parMultiplyMatricesOf(const T* a, const T* b, T* c,
+                           const int M,
+                           const int N,
+                           const int K){
+
+    /**
+     * Get the kernel compiled for T.
+     * */
+
+    cl::Kernel& kernel = getKernel(buildProgram("cached_matrix_multiplication.cl", getTileOptions(WG_SIZE[0]) + " " + ElementType<T>::options()), "multiplyMatricesWithCache");
+
+    /**
+     * Create buffers and allocate memory on the device.
+     * */
+
+    cl::Buffer aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, M * K * sizeof(T));
+    cl::Buffer bBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, K * N * sizeof(T));
+    cl::Buffer cBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY, M * N * sizeof(T));
+    std::string name = ElementType<T>::name();
+    queue.enqueueWriteBuffer(aBuf, CL_FALSE, 0, M * K * sizeof(T), a, NULL, profileEvent(HOST_TO_DEVICE, "write a (" + name + ")"));
+    queue.enqueueWriteBuffer(bBuf, CL_FALSE, 0, K * N * sizeof(T), b, NULL, profileEvent(HOST_TO_DEVICE, "write b (" + name + ")"));
+
     /**
      * Execute the kernel function and collect its result.
      * */
 
-    cl::CommandQueue queue(context, device);
-    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(N, M), cl::NDRange(WG_SIZE[0], WG_SIZE[1]));
-    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, M * N * sizeof(int), c);
+    kernel.setArg(0, aBuf);
+    kernel.setArg(1, bBuf);
+    kernel.setArg(2, cBuf);
+    kernel.setArg(3, M);
+    kernel.setArg(4, N);
+    kernel.setArg(5, K);
+
+    cl::NDRange global((N + WG_SIZE[0] - 1) / WG_SIZE[0] * WG_SIZE[0], (M + WG_SIZE[1] - 1) / WG_SIZE[1] * WG_SIZE[1]);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NDRange(WG_SIZE[0], WG_SIZE[1]), NULL, profileEvent(KERNEL, "multiplyMatricesWithCache (" + name + ")"));
+    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, M * N * sizeof(T), c, NULL, profileEvent(DEVICE_TO_HOST, "read c (" + name + ")"));
+
+    releaseBuffer(aBuf);
+    releaseBuffer(bBuf);
+    releaseBuffer(cBuf);
+}
+
+/**
+ * Benchmark parMultiplyMatricesOf<T> over matrices of the given shape,
+ * appending its result to results, and check it against seqMultiplyMatricesOf<T>.
+ * */
+
+template<class T>
+bool benchmarkMatricesOf(const int M, const int N, const int K,
+                         const BenchmarkOptions& options,
+                         std::vector<BenchmarkResult>& results){
+    return benchmarkElementType<T>((size_t) M * K, (size_t) K * N, (size_t) M * N,
+        [&](const T* a, const T* b, T* c){ seqMultiplyMatricesOf(a, b, c, M, N, K); },
+        [&](const T* a, const T* b, T* c){ parMultiplyMatricesOf(a, b, c, M, N, K); },
+        options, 2.0 * M * N * K, GIGAFLOPS_PER_SECOND, results);
 }
 
 /**
@@ -0,0 +1,185 @@
+#include "autotuner.hpp"
+#include "options.hpp"
+#include "runtime.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+// =================================================================
+// ------------------------ Auxiliary Functions --------------------
+// =================================================================
+
+/**
+ * Return the path of the tuning database.
+ * */
+
+static std::string getTuningPath(){
+    const char* path = getenv("OPENCL_TUNING_DB");
+    return path ? std::string(path) : std::string(".opencl_tuning");
+}
+
+/**
+ * Return the key of a tuning entry, specific to the current device
+ * and driver.
+ * */
+
+static std::string getTuningKey(const std::string& name, const std::string& bucket){
+    return name + "|" + bucket + "|" + device.getInfo<CL_DEVICE_NAME>() + "|" + device.getInfo<CL_DRIVER_VERSION>();
+}
+
+/**
+ * Read every entry of the tuning database. Each line holds a key and a
+ * value separated by a tab.
+ * */
+
+static std::map<std::string, int> loadTuningDatabase(){
+    std::map<std::string, int> entries;
+    std::ifstream db(getTuningPath());
+    std::string line;
+    while(std::getline(db, line)){
+        size_t tab = line.rfind('\t');
+        if(tab != std::string::npos){
+            entries[line.substr(0, tab)] = atoi(line.c_str() + tab + 1);
+        }
+    }
+    return entries;
+}
+
+/**
+ * Write every entry of the tuning database.
+ * */
+
+static void storeTuningDatabase(const std::map<std::string, int>& entries){
+    std::ofstream db(getTuningPath());
+    for(auto it = entries.begin(); it != entries.end(); it++){
+        db << it->first << "\t" << it->second << "\n";
+    }
+    if(!db){
+        std::cerr << "Warning: could not write tuning database " << getTuningPath() << std::endl;
+    }
+}
+
+// =================================================================
+// ----------------------- Autotuner Functions ---------------------
+// =================================================================
+
+/**
+ * Round a problem size up to a power-of-two bucket.
+ * */
+
+std::string getSizeBucket(size_t size){
+    size_t bucket = 1;
+    while(bucket < size){
+        bucket *= 2;
+    }
+    return std::to_string(bucket);
+}
+
+/**
+ * Return the build options that set SUB_SIZE.
+ * */
+
+std::string getTileOptions(int tileSize){
+    return "-D SUB_SIZE=" + std::to_string(tileSize);
+}
+
+/**
+ * Keep the square tiles (of tileSize x tileSize work-items) the device can
+ * run: each one is compiled as a SUB_SIZE variant of the kernel, which must
+ * accept that work-group size and fit its local memory. Tiles matching the
+ * preferred work-group size multiple are kept, unless none does.
+ * */
+
+std::vector<int> getTileCandidates(const std::string& kernelFile, const std::string& kernelName, const std::vector<int>& tiles, size_t localBytesPerItem){
+    std::vector<int> valid, preferred;
+    auto maxItems = device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+    cl_ulong localMemory = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+
+    for(size_t i = 0; i < tiles.size(); i++){
+        size_t tile = tiles[i];
+        size_t groupSize = tile * tile;
+
+        /**
+         * Check the device limits.
+         * */
+
+        if(maxItems.size() < 2 || tile > maxItems[0] || tile > maxItems[1] || groupSize * localBytesPerItem > localMemory){
+            continue;
+        }
+
+        /**
+         * Check the limits of the compiled kernel variant.
+         * */
+
+        cl::Kernel& kernel = getKernel(buildProgram(kernelFile, getTileOptions(tile)), kernelName);
+        if(groupSize > kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device)){
+            continue;
+        }
+
+        valid.push_back(tile);
+        size_t multiple = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device);
+        if(multiple == 0 || groupSize % multiple == 0){
+            preferred.push_back(tile);
+        }
+    }
+
+    return preferred.empty() ? valid : preferred;
+}
+
+/**
+ * Return the fastest candidate of a tunable parameter for the current device
+ * and problem-size bucket. With --tune, every candidate is measured (measure
+ * returns its time) and the fastest one is stored in the tuning database
+ * (OPENCL_TUNING_DB, .opencl_tuning by default). Otherwise, the stored
+ * choice is reused, falling back to the default value. Stored and default
+ * values that are not among the candidates (which the device can run) are
+ * replaced by the largest candidate.
+ * */
+
+int autotune(const std::string& name, const std::string& bucket, const std::vector<int>& candidates, int defaultValue, const std::function<double(int)>& measure){
+    if(candidates.empty()){
+        std::cerr << "No valid candidate to tune " << name << " (" << bucket << ") on this device." << std::endl;
+        exit(1);
+    }
+    std::map<std::string, int> entries = loadTuningDatabase();
+    std::string key = getTuningKey(name, bucket);
+
+    /**
+     * Reuse the stored choice, or the default value, if it is still a
+     * valid candidate.
+     * */
+
+    if(!hasFlag("tune")){
+        auto stored = entries.find(key);
+        if(stored != entries.end() && std::find(candidates.begin(), candidates.end(), stored->second) != candidates.end()){
+            return stored->second;
+        }
+        if(std::find(candidates.begin(), candidates.end(), defaultValue) != candidates.end()){
+            return defaultValue;
+        }
+        return *std::max_element(candidates.begin(), candidates.end());
+    }
+
+    /**
+     * Sweep the candidates and keep the fastest one.
+     * */
+
+    int best = candidates.front();
+    double bestTime = 0;
+    for(size_t i = 0; i < candidates.size(); i++){
+        double time = measure(candidates[i]);
+        std::cout << "Tuning " << name << " (" << bucket << "): " << candidates[i] << " -> " << time << " ms" << std::endl;
+        if(i == 0 || time < bestTime){
+            best = candidates[i];
+            bestTime = time;
+        }
+    }
+
+    entries[key] = best;
+    storeTuningDatabase(entries);
+    return best;
+}
@@ -0,0 +1,27 @@
+#ifndef AUTOTUNER_HPP
+#define AUTOTUNER_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// =================================================================
+// ----------------------- Autotuner Functions ---------------------
+// =================================================================
+
+std::string getSizeBucket(size_t size);                         // Round a problem size up to a power-of-two bucket.
+
+std::string getTileOptions(int tileSize);                       // Return the build options that set SUB_SIZE.
+
+std::vector<int> getTileCandidates(const std::string& kernelFile,
+                                   const std::string& kernelName,
+                                   const std::vector<int>& tiles,
+                                   size_t localBytesPerItem);   // Keep the square tiles the device can run.
+
+int autotune(const std::string& name,
+             const std::string& bucket,
+             const std::vector<int>& candidates,
+             int defaultValue,
+             const std::function<double(int)>& measure);        // Return the fastest candidate (tuned or stored).
+
+#endif
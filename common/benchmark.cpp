@@ -0,0 +1,140 @@
+#include "benchmark.hpp"
+#include "options.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// =================================================================
+// ------------------------ Auxiliary Functions --------------------
+// =================================================================
+
+/**
+ * Return the p-th percentile (0 < p <= 100) of sorted samples using
+ * the nearest-rank method.
+ * */
+
+static double getPercentile(const std::vector<double>& sorted, double p){
+    size_t rank = (size_t) std::ceil(p / 100 * sorted.size());
+    return sorted[std::max(rank, (size_t) 1) - 1];
+}
+
+// =================================================================
+// --------------------- Benchmark Functions -----------------------
+// =================================================================
+
+/**
+ * Read --warmup and --reps (or BENCHMARK_WARMUP and BENCHMARK_REPS),
+ * falling back to one warm-up and the given number of repetitions.
+ * */
+
+BenchmarkOptions getBenchmarkOptions(int repetitions){
+    BenchmarkOptions options;
+    options.warmup = std::max(0, getIntOption("warmup", "BENCHMARK_WARMUP", 1));
+    options.repetitions = std::max(1, getIntOption("reps", "BENCHMARK_REPS", repetitions));
+    return options;
+}
+
+/**
+ * Time the executions of fn with a monotonic wall clock. Asynchronous
+ * work must be finished by fn itself (e.g. by a blocking read).
+ * */
+
+BenchmarkResult runBenchmark(const std::string& name, const std::function<void()>& fn, const BenchmarkOptions& options, double work, ThroughputUnit unit){
+
+    /**
+     * Run the untimed warm-up executions.
+     * */
+
+    for(int i = 0; i < options.warmup; i++){
+        fn();
+    }
+
+    /**
+     * Time each execution separately, collecting the profiling events
+     * between them (never inside a timed execution).
+     * */
+
+    std::vector<double> samples(options.repetitions);
+    for(int i = 0; i < options.repetitions; i++){
+        collectProfileIfFull();
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        samples[i] = std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    /**
+     * Compute the statistics of the samples.
+     * */
+
+    BenchmarkResult result;
+    result.name = name;
+    result.warmup = options.warmup;
+    result.repetitions = options.repetitions;
+    result.unit = unit;
+
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    result.minMs = sorted.front();
+    result.p95Ms = getPercentile(sorted, 95);
+    result.p99Ms = getPercentile(sorted, 99);
+    size_t mid = sorted.size() / 2;
+    result.medianMs = sorted.size() % 2 ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
+
+    double sum = 0;
+    for(size_t i = 0; i < samples.size(); i++){
+        sum += samples[i];
+    }
+    result.meanMs = sum / samples.size();
+
+    double squares = 0;
+    for(size_t i = 0; i < samples.size(); i++){
+        squares += (samples[i] - result.meanMs) * (samples[i] - result.meanMs);
+    }
+    result.stddevMs = samples.size() > 1 ? std::sqrt(squares / (samples.size() - 1)) : 0;
+
+    /**
+     * Compute the throughput of the median execution.
+     * */
+
+    double seconds = result.medianMs * 1e-3;
+    if(unit != NO_THROUGHPUT && seconds > 0){
+        double scale = unit == MEGAPIXELS_PER_SECOND ? 1e6 : 1e9;
+        result.throughput = work / scale / seconds;
+    }
+    return result;
+}
+
+/**
+ * Return the name of a throughput unit.
+ * */
+
+const char* getThroughputUnitName(ThroughputUnit unit){
+    switch(unit){
+        case GIGABYTES_PER_SECOND: return "GB/s";
+        case GIGAFLOPS_PER_SECOND: return "GFLOP/s";
+        case MEGAPIXELS_PER_SECOND: return "Mpixel/s";
+        default: return "";
+    }
+}
+
+/**
+ * Print the statistics of a benchmark.
+ * */
+
+void printBenchmark(const BenchmarkResult& result){
+    std::cout << "\t" << result.name << ": median " << result.medianMs << " ms"
+    << " (min " << result.minMs
+    << ", p95 " << result.p95Ms
+    << ", p99 " << result.p99Ms
+    << ", stddev " << result.stddevMs
+    << " ms; " << result.repetitions << " reps, " << result.warmup << " warm-up)";
+    if(result.unit != NO_THROUGHPUT){
+        std::cout << ", " << result.throughput << " " << getThroughputUnitName(result.unit);
+    }
+    std::cout << ";" << std::endl;
+}
@@ -0,0 +1,65 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <functional>
+#include <string>
+
+// =================================================================
+// --------------------- Benchmark Structures ----------------------
+// =================================================================
+
+/**
+ * Units used to report the throughput of a benchmark.
+ * */
+
+enum ThroughputUnit {
+    NO_THROUGHPUT,          // Report only timings.
+    GIGABYTES_PER_SECOND,   // Work is given in bytes.
+    GIGAFLOPS_PER_SECOND,   // Work is given in arithmetic operations.
+    MEGAPIXELS_PER_SECOND   // Work is given in pixels.
+};
+
+/**
+ * Number of untimed and timed executions of a benchmark.
+ * */
+
+struct BenchmarkOptions {
+    int warmup = 1;         // The number of executions discarded before timing.
+    int repetitions = 10;   // The number of timed executions.
+};
+
+/**
+ * Wall-clock statistics of a benchmark, in ms.
+ * */
+
+struct BenchmarkResult {
+    std::string name;                       // The name of the benchmark.
+    int warmup = 0;                         // The number of executions discarded.
+    int repetitions = 0;                    // The number of timed executions.
+    double minMs = 0;                       // The fastest execution.
+    double medianMs = 0;                    // The median execution.
+    double meanMs = 0;                      // The mean execution.
+    double p95Ms = 0;                       // The 95th percentile.
+    double p99Ms = 0;                       // The 99th percentile.
+    double stddevMs = 0;                    // The sample standard deviation.
+    double throughput = 0;                  // The throughput of the median execution.
+    ThroughputUnit unit = NO_THROUGHPUT;    // The unit of the throughput.
+};
+
+// =================================================================
+// --------------------- Benchmark Functions -----------------------
+// =================================================================
+
+BenchmarkOptions getBenchmarkOptions(int repetitions = 10);     // Read --warmup and --reps (or BENCHMARK_WARMUP/REPS).
+
+BenchmarkResult runBenchmark(const std::string& name,
+                             const std::function<void()>& fn,
+                             const BenchmarkOptions& options,
+                             double work = 0,
+                             ThroughputUnit unit = NO_THROUGHPUT);  // Time the executions of fn.
+
+const char* getThroughputUnitName(ThroughputUnit unit);          // Return the name of a throughput unit.
+
+void printBenchmark(const BenchmarkResult& result);             // Print the statistics of a benchmark.
+
+#endif
@@ -0,0 +1,168 @@
+#include "buffer_pool.hpp"
+#include "runtime.hpp"
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+// =================================================================
+// ------------------------ Pool State -----------------------------
+// =================================================================
+
+static std::map<std::pair<cl_mem_flags, size_t>, std::vector<cl::Buffer> > freeBuffers;    // Free buffers indexed by flags and size class.
+static std::map<cl_mem, std::pair<cl_mem_flags, size_t> > usedBuffers;                    // Flags and size class of the buffers in use.
+static BufferPoolStats stats;                                                               // The pool usage statistics.
+
+// =================================================================
+// ------------------------ Auxiliary Functions --------------------
+// =================================================================
+
+/**
+ * Round a size up to its size class. Classes are split in four steps
+ * per power of two (e.g. 4096, 5120, 6144, 7168, 8192), which wastes
+ * at most 25% of each allocation.
+ * */
+
+static size_t getSizeClass(size_t size){
+    const size_t MIN_CLASS = 256;
+    if(size <= MIN_CLASS){
+        return MIN_CLASS;
+    }
+
+    size_t power = MIN_CLASS;
+    while(power * 2 < size){
+        power *= 2;
+    }
+
+    size_t step = power / 4;
+    return ((size + step - 1) / step) * step;
+}
+
+/**
+ * Free the buffers of a free list and update the statistics.
+ * */
+
+static void freeList(const std::pair<cl_mem_flags, size_t>& key, std::vector<cl::Buffer>& buffers){
+    stats.bytesResident -= key.second * buffers.size();
+    buffers.clear();
+}
+
+// =================================================================
+// ------------------------ Pool Functions -------------------------
+// =================================================================
+
+/**
+ * Return a device buffer of at least size bytes. Pooled buffers cannot
+ * be initialized from host memory, so the flags must not include
+ * CL_MEM_COPY_HOST_PTR nor CL_MEM_USE_HOST_PTR: write them instead.
+ * */
+
+cl::Buffer acquireBuffer(cl_mem_flags flags, size_t size){
+
+    if(flags & (CL_MEM_COPY_HOST_PTR | CL_MEM_USE_HOST_PTR)){
+        std::cerr << "Error!\nPooled buffers cannot use host pointers." << std::endl;
+        exit(1);
+    }
+
+    auto key = std::make_pair(flags, getSizeClass(size));
+    stats.requests++;
+
+    /**
+     * Recycle a free buffer of the same flags and size class.
+     * */
+
+    cl::Buffer buffer;
+    std::vector<cl::Buffer>& buffers = freeBuffers[key];
+    if(!buffers.empty()){
+        buffer = buffers.back();
+        buffers.pop_back();
+        stats.hits++;
+    }
+
+    /**
+     * Otherwise, allocate a new one. If the device is out of memory,
+     * free the buffers that are not in use and try once more.
+     * */
+
+    else{
+        cl_int err;
+        buffer = cl::Buffer(context, flags, key.second, NULL, &err);
+        if(err != CL_SUCCESS){
+            trimBufferPool();
+            buffer = cl::Buffer(context, flags, key.second, NULL, &err);
+        }
+        if(err != CL_SUCCESS){
+            std::cerr << "Error!\nCould not allocate a device buffer of " << key.second << " bytes (" << err << ")." << std::endl;
+            exit(1);
+        }
+
+        stats.bytesResident += key.second;
+        if(stats.bytesResident > stats.peakBytesResident){
+            stats.peakBytesResident = stats.bytesResident;
+        }
+    }
+
+    usedBuffers[buffer()] = key;
+    stats.bytesInUse += key.second;
+    return buffer;
+}
+
+/**
+ * Give a buffer back to the pool for later reuse. A buffer used only on
+ * the shared in-order queue may be released while commands using it are
+ * still pending, since its next user is enqueued after them. A buffer used
+ * on another queue (e.g. a stream queue of getStreamQueue) may only be
+ * released after that queue has finished, or its next user could overwrite
+ * it while those commands still run.
+ * */
+
+void releaseBuffer(const cl::Buffer& buffer){
+    auto used = usedBuffers.find(buffer());
+    if(used == usedBuffers.end()){
+        return;
+    }
+
+    freeBuffers[used->second].push_back(buffer);
+    stats.bytesInUse -= used->second.second;
+    usedBuffers.erase(used);
+}
+
+/**
+ * Free every buffer that is not in use.
+ * */
+
+void trimBufferPool(){
+    for(auto it = freeBuffers.begin(); it != freeBuffers.end(); it++){
+        freeList(it->first, it->second);
+    }
+    freeBuffers.clear();
+}
+
+/**
+ * Free every buffer and reset the statistics.
+ * */
+
+void clearBufferPool(){
+    freeBuffers.clear();
+    usedBuffers.clear();
+    stats = BufferPoolStats();
+}
+
+/**
+ * Return the pool usage statistics.
+ * */
+
+BufferPoolStats getBufferPoolStats(){
+    return stats;
+}
+
+/**
+ * Print the pool usage statistics.
+ * */
+
+void printBufferPoolStats(){
+    double hitRate = stats.requests ? 100.0 * stats.hits / stats.requests : 0.0;
+    std::cout << "Buffer pool: \n\tHit rate: " << hitRate << "\% (" << stats.hits << "/" << stats.requests << ");"
+    << "\n\tResident: " << stats.bytesResident << " bytes;"
+    << "\n\tPeak footprint: " << stats.peakBytesResident << " bytes." << std::endl;
+}
@@ -0,0 +1,38 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <CL/cl.hpp>
+
+// =================================================================
+// ------------------------ Pool Structures ------------------------
+// =================================================================
+
+/**
+ * Usage statistics of the device buffer pool.
+ * */
+
+struct BufferPoolStats {
+    size_t requests = 0;            // The number of buffers acquired.
+    size_t hits = 0;                // The number of requests served by a recycled buffer.
+    size_t bytesResident = 0;       // The bytes currently allocated by the pool (in use or free).
+    size_t bytesInUse = 0;          // The bytes currently handed out to callers.
+    size_t peakBytesResident = 0;   // The highest value ever reached by bytesResident.
+};
+
+// =================================================================
+// ------------------------ Pool Functions -------------------------
+// =================================================================
+
+cl::Buffer acquireBuffer(cl_mem_flags flags, size_t size);  // Return a device buffer of at least size bytes.
+
+void releaseBuffer(const cl::Buffer& buffer);               // Give a buffer back to the pool for later reuse.
+
+void trimBufferPool();                                      // Free every buffer that is not in use.
+
+void clearBufferPool();                                     // Free every buffer and reset the statistics.
+
+BufferPoolStats getBufferPoolStats();                       // Return the pool usage statistics.
+
+void printBufferPoolStats();                                // Print the pool usage statistics.
+
+#endif
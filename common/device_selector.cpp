@@ -0,0 +1,234 @@
+#include "device_selector.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+// =================================================================
+// ------------------------ Auxiliary Functions --------------------
+// =================================================================
+
+/**
+ * Return a lowercase copy of a string.
+ * */
+
+static std::string toLower(std::string text){
+    std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+    return text;
+}
+
+/**
+ * Parse a "P" or "P:D" selector into platform and device indices.
+ * */
+
+static bool parseIndices(const std::string& selector, int& platformIndex, int& deviceIndex){
+    char* end;
+    platformIndex = (int) strtol(selector.c_str(), &end, 10);
+    if(end == selector.c_str()){
+        return false;
+    }
+    deviceIndex = 0;
+    if(*end == ':'){
+        const char* start = end + 1;
+        deviceIndex = (int) strtol(start, &end, 10);
+        if(end == start){
+            return false;
+        }
+    }
+    return *end == '\0';
+}
+
+// =================================================================
+// ----------------------- Selector Functions ----------------------
+// =================================================================
+
+/**
+ * Return the devices of every OpenCL platform.
+ * */
+
+std::vector<DeviceEntry> getAllDevices(){
+    
+    /**
+     * Search for all the OpenCL platforms available and check
+     * if there are any.
+     * */
+
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+
+    if (platforms.empty()){
+        std::cerr << "No platforms found!" << std::endl;
+        exit(1);
+    }
+
+    /**
+     * Search for all the devices on every platform and check if
+     * there are any available.
+     * */
+
+    std::vector<DeviceEntry> entries;
+    for(size_t p = 0; p < platforms.size(); p++){
+        std::vector<cl::Device> devices;
+        platforms[p].getDevices(CL_DEVICE_TYPE_ALL, &devices);
+        std::string platformName = platforms[p].getInfo<CL_PLATFORM_NAME>();
+        for(size_t d = 0; d < devices.size(); d++){
+            DeviceEntry entry = {devices[d], (int) p, (int) d, platformName};
+            entries.push_back(entry);
+        }
+    }
+
+    if (entries.empty()){
+        std::cerr << "No devices found!" << std::endl;
+        exit(1);
+    }
+
+    return entries;
+}
+
+/**
+ * Measure the device-to-device copy bandwidth, in GB/s. OpenCL does not
+ * report memory bandwidth, so a buffer copy is timed with events.
+ * */
+
+double measureBandwidth(const cl::Device& device){
+
+    /**
+     * Create a temporary context, queue and a pair of buffers no larger
+     * than the device allows.
+     * */
+
+    size_t size = 64 << 20;
+    size = (size_t) std::min((cl_ulong) size, device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>() / 2);
+
+    cl_int queueErr, srcErr, dstErr;
+    cl::Context context(device);
+    cl::CommandQueue queue(context, device, CL_QUEUE_PROFILING_ENABLE, &queueErr);
+    cl::Buffer src(context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, size, NULL, &srcErr);
+    cl::Buffer dst(context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, size, NULL, &dstErr);
+    if(queueErr != CL_SUCCESS || srcErr != CL_SUCCESS || dstErr != CL_SUCCESS){
+        return 0;
+    }
+
+    /**
+     * Copy once to page the buffers in, then time a second copy
+     * (which reads and writes size bytes).
+     * */
+
+    cl::Event event;
+    queue.enqueueCopyBuffer(src, dst, 0, 0, size);
+    if(queue.enqueueCopyBuffer(src, dst, 0, 0, size, NULL, &event) != CL_SUCCESS){
+        return 0;
+    }
+    queue.finish();
+
+    double ns = (double) event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - (double) event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+    return ns > 0 ? 2.0 * size / ns : 0;
+}
+
+/**
+ * Score devices by compute units, clock and bandwidth. Compute throughput
+ * (compute units times clock) and memory bandwidth are normalized by their
+ * highest value among the devices and combined by their geometric mean.
+ * */
+
+std::vector<double> scoreDevices(const std::vector<DeviceEntry>& entries){
+
+    std::vector<double> compute(entries.size()), bandwidth(entries.size());
+    double maxCompute = 0, maxBandwidth = 0;
+    for(size_t i = 0; i < entries.size(); i++){
+        compute[i] = (double) entries[i].device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() * entries[i].device.getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>();
+        bandwidth[i] = measureBandwidth(entries[i].device);
+        maxCompute = std::max(maxCompute, compute[i]);
+        maxBandwidth = std::max(maxBandwidth, bandwidth[i]);
+    }
+
+    std::vector<double> scores(entries.size());
+    for(size_t i = 0; i < entries.size(); i++){
+        double c = maxCompute > 0 ? compute[i] / maxCompute : 0;
+        double b = maxBandwidth > 0 ? bandwidth[i] / maxBandwidth : 1;
+        scores[i] = std::sqrt(c * b);
+    }
+    return scores;
+}
+
+/**
+ * Return the device matching a selector, which is one of:
+ *  - empty: the first device of the first platform;
+ *  - "P" or "P:D": the device D (0 by default) of the platform P;
+ *  - "cpu", "gpu" or "accelerator": the first device of that type;
+ *  - "fastest": the device with the highest score (see scoreDevices);
+ *  - anything else: the first device whose name, vendor or platform name
+ *    contains it (ignoring case), e.g. "nvidia" or "pocl".
+ * */
+
+cl::Device selectDevice(const std::string& selector){
+    std::vector<DeviceEntry> entries = getAllDevices();
+    std::string lower = toLower(selector);
+
+    if(lower.empty()){
+        return entries.front().device;
+    }
+
+    /**
+     * Select by platform and device indices.
+     * */
+
+    int platformIndex, deviceIndex;
+    if(parseIndices(lower, platformIndex, deviceIndex)){
+        for(size_t i = 0; i < entries.size(); i++){
+            if(entries[i].platformIndex == platformIndex && entries[i].deviceIndex == deviceIndex){
+                return entries[i].device;
+            }
+        }
+        std::cerr << "Error!\nNo device " << deviceIndex << " on platform " << platformIndex << "." << std::endl;
+        exit(1);
+    }
+
+    /**
+     * Select by device type.
+     * */
+
+    cl_device_type type = lower == "cpu" ? CL_DEVICE_TYPE_CPU
+                        : lower == "gpu" ? CL_DEVICE_TYPE_GPU
+                        : lower == "accelerator" ? CL_DEVICE_TYPE_ACCELERATOR : 0;
+    if(type != 0){
+        for(size_t i = 0; i < entries.size(); i++){
+            if(entries[i].device.getInfo<CL_DEVICE_TYPE>() & type){
+                return entries[i].device;
+            }
+        }
+        std::cerr << "Error!\nNo " << lower << " device found." << std::endl;
+        exit(1);
+    }
+
+    /**
+     * Select the device with the highest score.
+     * */
+
+    if(lower == "fastest"){
+        std::vector<double> scores = scoreDevices(entries);
+        size_t best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+        return entries[best].device;
+    }
+
+    /**
+     * Select by device name, device vendor or platform name.
+     * */
+
+    for(size_t i = 0; i < entries.size(); i++){
+        std::string fields[] = {
+            entries[i].device.getInfo<CL_DEVICE_NAME>(),
+            entries[i].device.getInfo<CL_DEVICE_VENDOR>(),
+            entries[i].platformName
+        };
+        for(size_t f = 0; f < 3; f++){
+            if(toLower(fields[f]).find(lower) != std::string::npos){
+                return entries[i].device;
+            }
+        }
+    }
+    std::cerr << "Error!\nNo device matches \"" << selector << "\"." << std::endl;
+    exit(1);
+}
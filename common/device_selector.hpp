@@ -0,0 +1,35 @@
+#ifndef DEVICE_SELECTOR_HPP
+#define DEVICE_SELECTOR_HPP
+
+#include <CL/cl.hpp>
+#include <string>
+#include <vector>
+
+// =================================================================
+// ----------------------- Selector Structures ---------------------
+// =================================================================
+
+/**
+ * A device and its position among the OpenCL platforms.
+ * */
+
+struct DeviceEntry {
+    cl::Device device;      // The device.
+    int platformIndex;      // The index of its platform.
+    int deviceIndex;        // The index of the device in its platform.
+    std::string platformName; // The name of its platform.
+};
+
+// =================================================================
+// ----------------------- Selector Functions ----------------------
+// =================================================================
+
+std::vector<DeviceEntry> getAllDevices();                       // Return the devices of every OpenCL platform.
+
+double measureBandwidth(const cl::Device& device);              // Measure the device-to-device copy bandwidth, in GB/s.
+
+std::vector<double> scoreDevices(const std::vector<DeviceEntry>& entries);  // Score devices by compute units, clock and bandwidth.
+
+cl::Device selectDevice(const std::string& selector);           // Return the device matching a selector.
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef ELEMENT_TYPE_HPP
+#define ELEMENT_TYPE_HPP
+
+#include <CL/cl.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "half.hpp"
+#include "runtime.hpp"
+
+// =================================================================
+// ------------------------- Element Types -------------------------
+// =================================================================
+
+/**
+ * Properties of the element types of the typed kernels: the build options
+ * that set ELEMENT_TYPE in a kernel file (with the extension it needs),
+ * whether the device supports it, conversions from and to double, the host
+ * sum, and the relative tolerance used to compare host and device results,
+ * which may add the elements in different orders and precisions.
+ *
+ * Half values are built as ELEMENT_TYPE=half with ENABLE_FP16 when the
+ * device supports cl_khr_fp16, and with HALF_STORAGE otherwise (stored as
+ * half with vload_half/vstore_half and computed as float).
+ * */
+
+template<class T> struct ElementType;
+
+template<> struct ElementType<int> {
+    static const char* name(){ return "int"; }
+    static std::string options(){ return "-D ELEMENT_TYPE=int"; }
+    static bool supported(){ return true; }
+    static double tolerance(){ return 0; }
+    static int fromDouble(double value){ return (int) value; }
+    static double toDouble(int value){ return value; }
+    static int add(int a, int b){ return a + b; }
+};
+
+template<> struct ElementType<cl_long> {
+    static const char* name(){ return "int64"; }
+    static std::string options(){ return "-D ELEMENT_TYPE=long"; }
+    static bool supported(){ return true; }
+    static double tolerance(){ return 0; }
+    static cl_long fromDouble(double value){ return (cl_long) value; }
+    static double toDouble(cl_long value){ return (double) value; }
+    static cl_long add(cl_long a, cl_long b){ return a + b; }
+};
+
+template<> struct ElementType<float> {
+    static const char* name(){ return "float"; }
+    static std::string options(){ return "-D ELEMENT_TYPE=float"; }
+    static bool supported(){ return true; }
+    static double tolerance(){ return 1e-5; }
+    static float fromDouble(double value){ return (float) value; }
+    static double toDouble(float value){ return value; }
+    static float add(float a, float b){ return a + b; }
+};
+
+template<> struct ElementType<double> {
+    static const char* name(){ return "double"; }
+    static std::string options(){ return "-D ELEMENT_TYPE=double -D ENABLE_FP64"; }
+    static bool supported(){ return hasDeviceExtension("cl_khr_fp64"); }
+    static double tolerance(){ return 1e-10; }
+    static double fromDouble(double value){ return value; }
+    static double toDouble(double value){ return value; }
+    static double add(double a, double b){ return a + b; }
+};
+
+template<> struct ElementType<Half> {
+    static const char* name(){ return "half"; }
+    static std::string options(){ return hasDeviceExtension("cl_khr_fp16") ? "-D ELEMENT_TYPE=half -D ENABLE_FP16" : "-D HALF_STORAGE"; }
+    static bool supported(){ return true; }
+    static double tolerance(){ return 2e-3; }
+    static Half fromDouble(double value){ return Half{floatToHalf((float) value)}; }
+    static double toDouble(Half value){ return halfToFloat(value.bits); }
+    static Half add(Half a, Half b){ return Half{floatToHalf(halfToFloat(a.bits) + halfToFloat(b.bits))}; }
+};
+
+// =================================================================
+// ------------------------ Element Functions ----------------------
+// =================================================================
+
+/**
+ * Check if the N elements of T x1 and x2 are equal up to the relative
+ * tolerance of T (exactly, for integer types).
+ * */
+
+template<class T>
+bool checkCloseness(const T* x1, const T* x2, const size_t N){
+    for(size_t i = 0; i < N; i++){
+        double x = ElementType<T>::toDouble(x1[i]);
+        double y = ElementType<T>::toDouble(x2[i]);
+        if(std::fabs(x - y) > ElementType<T>::tolerance() * std::max(1.0, std::fabs(x))){
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Fill x with the values 0, step, ..., (period - 1) * step repeated. With
+ * small multiples of powers of two these are exact in every floating type,
+ * while their sums and products are not, so the device rounding is compared.
+ * */
+
+template<class T>
+void fillElements(std::vector<T>& x, const int period, const double step){
+    for(size_t i = 0; i < x.size(); i++){
+        x[i] = ElementType<T>::fromDouble((i % period) * step);
+    }
+}
+
+/**
+ * Sequentially performs the operation c[M,N] = a[M,K] * b[K,N] over
+ * matrices of T, summing the products in double precision.
+ * */
+
+template<class T>
+void seqMultiplyMatricesOf(const T* a, const T* b, T* c,
+                           const int M,
+                           const int N,
+                           const int K){
+    for(int i = 0; i < M; i++){
+        for(int j = 0; j < N; j++){
+            double sum = 0;
+            for(int k = 0; k < K; k++){
+                sum += ElementType<T>::toDouble(a[i*K + k]) * ElementType<T>::toDouble(b[j + k*N]);
+            }
+            c[i*N + j] = ElementType<T>::fromDouble(sum);
+        }
+    }
+}
+
+/**
+ * Benchmark parFn, which computes c (cSize elements) from a and b (aSize
+ * and bSize elements) of T on the device, appending its result (named
+ * after T) to results, and check it against seqFn. Types the device does
+ * not support are skipped.
+ * */
+
+template<class T>
+bool benchmarkElementType(const size_t aSize, const size_t bSize, const size_t cSize,
+                          const std::function<void(const T*, const T*, T*)>& seqFn,
+                          const std::function<void(const T*, const T*, T*)>& parFn,
+                          const BenchmarkOptions& options,
+                          double work, ThroughputUnit unit,
+                          std::vector<BenchmarkResult>& results){
+    if(!ElementType<T>::supported()){
+        std::cout << "Skipping " << ElementType<T>::name() << ": not supported by the device." << std::endl;
+        return true;
+    }
+
+    std::vector<T> a(aSize), b(bSize), cs(cSize), cp(cSize);
+    fillElements(a, 8, 0.25);
+    fillElements(b, 5, 0.5);
+    seqFn(a.data(), b.data(), cs.data());
+
+    results.push_back(runBenchmark(std::string("Parallel (") + ElementType<T>::name() + ")", [&]{
+        parFn(a.data(), b.data(), cp.data());
+    }, options, work, unit));
+    return checkCloseness(cs.data(), cp.data(), cSize);
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include "expression.hpp"
+#include "buffer_pool.hpp"
+#include "profiler.hpp"
+#include "runtime.hpp"
+
+#include <map>
+
+// =================================================================
+// ---------------------- Expression Cache -------------------------
+// =================================================================
+
+static std::map<std::string, cl::Kernel> expressionKernels;    // Generated kernels indexed by signature.
+
+// =================================================================
+// ---------------------- Auxiliary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the OpenCL source of the kernel computing out[i] = body. Each
+ * work-item loops over the arrays with the stride of the whole grid,
+ * so any N can be run by the same launch shape.
+ * */
+
+static std::string getExpressionSource(const std::string& body, const ExpressionArgs& args){
+    std::string params;
+    for(size_t i = 0; i < args.arrays.size(); i++){
+        params += "__global const int* a" + std::to_string(i) + ", ";
+    }
+    for(size_t i = 0; i < args.scalars.size(); i++){
+        params += "const int s" + std::to_string(i) + ", ";
+    }
+
+    return "__kernel void evaluateExpression(" + params + "__global int* out, const int N){\n"
+           "    for(int i = get_global_id(0); i < N; i += get_global_size(0)){\n"
+           "        out[i] = " + body + ";\n"
+           "    }\n"
+           "}\n";
+}
+
+/**
+ * Return the kernel computing out[i] = body, generating and compiling it
+ * on the first call with each signature. Since arrays and scalars are
+ * named by position, the body together with the number of operands
+ * identifies the kernel.
+ * */
+
+static cl::Kernel& getExpressionKernel(const std::string& body, const ExpressionArgs& args){
+    std::string signature = body + "|" + std::to_string(args.arrays.size()) + "|" + std::to_string(args.scalars.size());
+    auto cached = expressionKernels.find(signature);
+    if(cached != expressionKernels.end()){
+        return cached->second;
+    }
+
+    /**
+     * Generate the kernel, and have the runtime drop the cache on release
+     * when it gets its first kernel.
+     * */
+
+    if(expressionKernels.empty()){
+        addReleaseHook(clearExpressionCache);
+    }
+    cl::Program& generated = buildProgramFromSource("expression:" + signature, getExpressionSource(body, args));
+    return expressionKernels[signature] = cl::Kernel(generated, "evaluateExpression");
+}
+
+// =================================================================
+// ---------------------- Expression Functions ---------------------
+// =================================================================
+
+/**
+ * Run the kernel computing out[i] = body for i < N, transferring every
+ * array once and writing the result without any intermediate buffer.
+ * */
+
+void runExpression(const std::string& body, const ExpressionArgs& args, int* out, const int N){
+    if(N <= 0){
+        return;
+    }
+    cl::Kernel& kernel = getExpressionKernel(body, args);
+
+    /**
+     * Transfer the input arrays to pooled buffers.
+     * */
+
+    std::vector<cl::Buffer> inputs;
+    for(size_t i = 0; i < args.arrays.size(); i++){
+        inputs.push_back(acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, N * sizeof(int)));
+        queue.enqueueWriteBuffer(inputs[i], CL_FALSE, 0, N * sizeof(int), args.arrays[i], NULL, profileEvent(HOST_TO_DEVICE, "write a" + std::to_string(i)));
+    }
+    cl::Buffer outBuf = acquireBuffer(CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, N * sizeof(int));
+
+    /**
+     * Set kernel arguments in the order of getExpressionSource.
+     * */
+
+    cl_uint arg = 0;
+    for(size_t i = 0; i < inputs.size(); i++){
+        kernel.setArg(arg++, inputs[i]);
+    }
+    for(size_t i = 0; i < args.scalars.size(); i++){
+        kernel.setArg(arg++, args.scalars[i]);
+    }
+    kernel.setArg(arg++, outBuf);
+    kernel.setArg(arg++, N);
+
+    /**
+     * Launch at most four work-groups per compute unit (the kernel
+     * loops over the rest) and collect the result.
+     * */
+
+    size_t global = std::min<size_t>(N, 4 * 256 * device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>());
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global), cl::NullRange, NULL, profileEvent(KERNEL, "evaluateExpression"));
+    queue.enqueueReadBuffer(outBuf, CL_TRUE, 0, N * sizeof(int), out, NULL, profileEvent(DEVICE_TO_HOST, "read out"));
+
+    /**
+     * Give the buffers back to the pool for the next evaluation.
+     * */
+
+    for(size_t i = 0; i < inputs.size(); i++){
+        releaseBuffer(inputs[i]);
+    }
+    releaseBuffer(outBuf);
+}
+
+/**
+ * Release every generated kernel.
+ * */
+
+void clearExpressionCache(){
+    expressionKernels.clear();
+}
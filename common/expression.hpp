@@ -0,0 +1,153 @@
+#ifndef EXPRESSION_HPP
+#define EXPRESSION_HPP
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// =================================================================
+// --------------------- Expression Structures ---------------------
+// =================================================================
+
+/**
+ * Operands of an expression, in the order they appear in its kernel:
+ * every distinct host array becomes a buffer argument a0, a1, ... and
+ * every scalar a value argument s0, s1, ...
+ * */
+
+struct ExpressionArgs {
+    std::vector<const int*> arrays; // The host arrays read by the expression.
+    std::vector<int> scalars;       // The scalar values used by the expression.
+};
+
+/**
+ * Leaf of an expression tree reading a host array element-wise.
+ * */
+
+struct ArrayTerm {
+    const int* data;    // The host array.
+
+    std::string emit(ExpressionArgs& args) const {
+        size_t index = std::find(args.arrays.begin(), args.arrays.end(), data) - args.arrays.begin();
+        if(index == args.arrays.size()){
+            args.arrays.push_back(data);
+        }
+        return "a" + std::to_string(index) + "[i]";
+    }
+};
+
+/**
+ * Leaf of an expression tree holding a scalar value. Scalars are passed
+ * as kernel arguments, so that changing them does not compile a new kernel.
+ * */
+
+struct ScalarTerm {
+    int value;          // The scalar value.
+
+    std::string emit(ExpressionArgs& args) const {
+        args.scalars.push_back(value);
+        return "s" + std::to_string(args.scalars.size() - 1);
+    }
+};
+
+/**
+ * Node of an expression tree applying a binary operator (e.g. "+") or
+ * a two-argument OpenCL function (e.g. "min") to its operands.
+ * */
+
+template<class L, class R>
+struct BinaryTerm {
+    const char* op;     // The operator or function name.
+    bool function;      // Whether op is a function rather than an operator.
+    L left;             // The left operand.
+    R right;            // The right operand.
+
+    std::string emit(ExpressionArgs& args) const {
+        std::string l = left.emit(args);
+        std::string r = right.emit(args);
+        return function ? std::string(op) + "(" + l + ", " + r + ")" : "(" + l + " " + op + " " + r + ")";
+    }
+};
+
+/**
+ * Expression over int arrays. Combining expressions with operators only
+ * builds a tree; nothing runs until it is passed to evaluate.
+ * */
+
+template<class E>
+struct Expr {
+    E node;             // The root of the expression tree.
+};
+
+// =================================================================
+// --------------------- Expression Operators ----------------------
+// =================================================================
+
+/**
+ * Return an expression reading the host array data.
+ * */
+
+inline Expr<ArrayTerm> array(const int* data){
+    return Expr<ArrayTerm>{ArrayTerm{data}};
+}
+
+/**
+ * Define a binary operator (or function) between two expressions, and
+ * between an expression and a scalar (on either side).
+ * */
+
+#define EXPRESSION_BINARY(name, op, function)                                                   \
+    template<class L, class R>                                                                  \
+    Expr<BinaryTerm<L, R> > name(const Expr<L>& l, const Expr<R>& r){                           \
+        return Expr<BinaryTerm<L, R> >{BinaryTerm<L, R>{op, function, l.node, r.node}};         \
+    }                                                                                           \
+    template<class L>                                                                           \
+    Expr<BinaryTerm<L, ScalarTerm> > name(const Expr<L>& l, int r){                             \
+        return Expr<BinaryTerm<L, ScalarTerm> >{BinaryTerm<L, ScalarTerm>{op, function, l.node, ScalarTerm{r}}}; \
+    }                                                                                           \
+    template<class R>                                                                           \
+    Expr<BinaryTerm<ScalarTerm, R> > name(int l, const Expr<R>& r){                             \
+        return Expr<BinaryTerm<ScalarTerm, R> >{BinaryTerm<ScalarTerm, R>{op, function, ScalarTerm{l}, r.node}}; \
+    }
+
+EXPRESSION_BINARY(operator+, "+", false)
+EXPRESSION_BINARY(operator-, "-", false)
+EXPRESSION_BINARY(operator*, "*", false)
+EXPRESSION_BINARY(operator/, "/", false)
+EXPRESSION_BINARY(min, "min", true)
+EXPRESSION_BINARY(max, "max", true)
+
+#undef EXPRESSION_BINARY
+
+/**
+ * Return an expression clamping x to the range [lo, hi].
+ * */
+
+template<class E>
+Expr<BinaryTerm<BinaryTerm<E, ScalarTerm>, ScalarTerm> > clamp(const Expr<E>& x, int lo, int hi){
+    return min(max(x, lo), hi);
+}
+
+// =================================================================
+// --------------------- Expression Functions ----------------------
+// =================================================================
+
+void runExpression(const std::string& body,
+                   const ExpressionArgs& args,
+                   int* out, const int N);          // Run the kernel computing out[i] = body for i < N.
+
+void clearExpressionCache();                        // Release every generated kernel.
+
+/**
+ * Compute out[i] = expr[i] for the N elements of its arrays in a single
+ * kernel, generated (and compiled) once per expression signature.
+ * */
+
+template<class E>
+void evaluate(const Expr<E>& expr, int* out, const int N){
+    ExpressionArgs args;
+    std::string body = expr.node.emit(args);
+    runExpression(body, args, out, N);
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "half.hpp"
+
+#include <cmath>
+#include <cstring>
+
+// =================================================================
+// ------------------------ Half Functions -------------------------
+// =================================================================
+
+/**
+ * Round a float to the nearest half, with ties to even (the default
+ * rounding of vstore_half), so that host and device results match.
+ * */
+
+cl_half floatToHalf(float value){
+    cl_uint bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    cl_uint sign = (bits >> 16) & 0x8000;
+    int exponent = (int) ((bits >> 23) & 0xff) - 127 + 15;
+    cl_uint mantissa = bits & 0x7fffff;
+
+    /**
+     * Infinities and NaNs keep their class; overflows become infinities.
+     * */
+
+    if(((bits >> 23) & 0xff) == 0xff){
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    if(exponent >= 31){
+        return sign | 0x7c00;
+    }
+
+    /**
+     * Values below the smallest normal half become subnormals (or zero).
+     * */
+
+    cl_uint shift = 13;
+    cl_uint half = ((cl_uint) exponent << 10) | (mantissa >> 13);
+    if(exponent <= 0){
+        if(exponent < -10){
+            return sign;
+        }
+        mantissa |= 0x800000;
+        shift = 14 - exponent;
+        half = mantissa >> shift;
+    }
+
+    /**
+     * Round the dropped bits to the nearest, ties to even. A carry out of
+     * the mantissa correctly increments the exponent (up to infinity).
+     * */
+
+    cl_uint remainder = mantissa & ((1u << shift) - 1);
+    cl_uint halfway = 1u << (shift - 1);
+    if(remainder > halfway || (remainder == halfway && (half & 1))){
+        half++;
+    }
+    return sign | half;
+}
+
+/**
+ * Return the (exact) float value of a half.
+ * */
+
+float halfToFloat(cl_half value){
+    cl_uint sign = (cl_uint) (value & 0x8000) << 16;
+    cl_uint exponent = (value >> 10) & 0x1f;
+    cl_uint mantissa = value & 0x3ff;
+
+    if(exponent == 0){
+        float subnormal = std::ldexp((float) mantissa, -24);
+        return sign ? -subnormal : subnormal;
+    }
+
+    cl_uint bits = sign | (exponent == 31 ? 0x7f800000 | (mantissa << 13) : ((exponent + 112) << 23) | (mantissa << 13));
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
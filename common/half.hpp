@@ -0,0 +1,28 @@
+#ifndef HALF_HPP
+#define HALF_HPP
+
+#include <CL/cl.hpp>
+
+// =================================================================
+// ------------------------ Half Structures ------------------------
+// =================================================================
+
+/**
+ * Host storage of an OpenCL half (IEEE 754 binary16) value. It wraps
+ * cl_half, which is a plain unsigned short, so that templates can tell
+ * half arrays from integer ones.
+ * */
+
+struct Half {
+    cl_half bits;   // The binary16 encoding of the value.
+};
+
+// =================================================================
+// ------------------------ Half Functions -------------------------
+// =================================================================
+
+cl_half floatToHalf(float value);   // Round a float to the nearest half (ties to even).
+
+float halfToFloat(cl_half value);   // Return the (exact) float value of a half.
+
+#endif
@@ -0,0 +1,81 @@
+#include "options.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+static std::vector<std::string> arguments;  // The command-line arguments of the example.
+
+// =================================================================
+// ----------------------- Options Functions -----------------------
+// =================================================================
+
+/**
+ * Store the command-line arguments of the example.
+ * */
+
+void parseOptions(int argc, char** argv){
+    arguments.assign(argv + 1, argv + argc);
+}
+
+/**
+ * Return the value of --name=value, of the environment variable envName
+ * or the default value, in this order of precedence.
+ * */
+
+std::string getOption(const std::string& name, const std::string& envName, const std::string& defaultValue){
+
+    /**
+     * Search the command-line arguments (the last occurrence wins).
+     * */
+
+    std::string prefix = "--" + name + "=";
+    for(size_t i = arguments.size(); i > 0; i--){
+        if(arguments[i - 1].compare(0, prefix.size(), prefix) == 0){
+            return arguments[i - 1].substr(prefix.size());
+        }
+    }
+
+    /**
+     * Search the environment.
+     * */
+
+    const char* value = envName.empty() ? NULL : getenv(envName.c_str());
+    return value ? std::string(value) : defaultValue;
+}
+
+/**
+ * Return the value of an integer option.
+ * */
+
+int getIntOption(const std::string& name, const std::string& envName, int defaultValue){
+    std::string value = getOption(name, envName, "");
+    if(value.empty()){
+        return defaultValue;
+    }
+
+    char* end;
+    long number = strtol(value.c_str(), &end, 10);
+    if(*end != '\0'){
+        std::cerr << "Error!\nInvalid value for option " << name << ": " << value << std::endl;
+        exit(1);
+    }
+    return (int) number;
+}
+
+/**
+ * Check if --name was passed in the command line.
+ * */
+
+bool hasFlag(const std::string& name){
+    for(size_t i = 0; i < arguments.size(); i++){
+        if(arguments[i] == "--" + name){
+            return true;
+        }
+    }
+    return false;
+}
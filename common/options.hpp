@@ -0,0 +1,22 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <string>
+
+// =================================================================
+// ----------------------- Options Functions -----------------------
+// =================================================================
+
+void parseOptions(int argc, char** argv);               // Store the command-line arguments of the example.
+
+std::string getOption(const std::string& name,
+                      const std::string& envName,
+                      const std::string& defaultValue); // Return the value of --name=value, of envName or the default.
+
+int getIntOption(const std::string& name,
+                 const std::string& envName,
+                 int defaultValue);                     // Return the value of an integer option.
+
+bool hasFlag(const std::string& name);                  // Check if --name was passed in the command line.
+
+#endif
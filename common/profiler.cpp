@@ -0,0 +1,187 @@
+#include "profiler.hpp"
+#include "runtime.hpp"
+
+#include <deque>
+#include <iostream>
+
+// =================================================================
+// ---------------------- Profiler State ---------------------------
+// =================================================================
+
+/**
+ * An event recorded by profileEvent() whose profiling data has not
+ * been read yet.
+ * */
+
+struct PendingEvent {
+    ProfileStage stage;     // The stage of the command.
+    std::string label;      // The label of the command.
+    cl::Event event;        // The event associated with the command.
+};
+
+static const size_t MAX_PENDING_EVENTS = 4096;  // The number of events kept before collectProfileIfFull collects them.
+static const size_t HARD_PENDING_EVENTS = 65536;// The number of events kept before profileEvent itself collects them.
+static std::deque<PendingEvent> pendingEvents;  // The events not collected yet (a deque keeps pointers valid).
+static Profile profile;                         // The accumulated profiling data.
+
+// =================================================================
+// ---------------------- Profiler Functions -----------------------
+// =================================================================
+
+/**
+ * Return an event to be passed to an enqueue call. The command queue must
+ * have been created with CL_QUEUE_PROFILING_ENABLE, as the runtime does.
+ * */
+
+cl::Event* profileEvent(ProfileStage stage, const std::string& label){
+
+    /**
+     * Bound the memory used by long runs. Collecting waits for the device,
+     * so it is left to collectProfileIfFull (called by runBenchmark between
+     * timed executions) unless a single execution records far more events.
+     * */
+
+    if(pendingEvents.size() >= HARD_PENDING_EVENTS){
+        collectProfile();
+    }
+
+    PendingEvent pending;
+    pending.stage = stage;
+    pending.label = label;
+    pendingEvents.push_back(pending);
+    return &pendingEvents.back().event;
+}
+
+/**
+ * Collect the recorded events if there are many of them. Callers use it
+ * outside of their timed regions, so that waiting for the device and
+ * reading the events never counts as run time.
+ * */
+
+void collectProfileIfFull(){
+    if(pendingEvents.size() >= MAX_PENDING_EVENTS){
+        collectProfile();
+    }
+}
+
+/**
+ * Wait for the recorded commands and accumulate their events.
+ * */
+
+void collectProfile(){
+    if(pendingEvents.empty()){
+        return;
+    }
+    queue.finish();
+
+    for(size_t i = 0; i < pendingEvents.size(); i++){
+        const cl::Event& event = pendingEvents[i].event;
+        if(event() == NULL){
+            continue;
+        }
+
+        /**
+         * Wait for the commands of other queues (see getStreamQueue).
+         * */
+
+        event.wait();
+
+        /**
+         * Read the timestamps (in ns) of the command.
+         * */
+
+        cl_ulong queued = event.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>();
+        cl_ulong submit = event.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>();
+        cl_ulong start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        cl_ulong end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+
+        /**
+         * Accumulate them, in ms, into the profile of its label.
+         * */
+
+        CommandProfile& command = profile[std::make_pair(pendingEvents[i].stage, pendingEvents[i].label)];
+        command.count++;
+        command.queuedMs += ((double) submit - (double) queued) * 1e-6;
+        command.submitMs += ((double) start - (double) submit) * 1e-6;
+        command.runMs += ((double) end - (double) start) * 1e-6;
+    }
+    pendingEvents.clear();
+}
+
+/**
+ * Return the accumulated profiling data.
+ * */
+
+Profile getProfile(){
+    collectProfile();
+    return profile;
+}
+
+/**
+ * Return the total run time of a stage, in ms.
+ * */
+
+double getStageTime(ProfileStage stage){
+    collectProfile();
+    double time = 0;
+    for(auto it = profile.begin(); it != profile.end(); it++){
+        if(it->first.first == stage){
+            time += it->second.runMs;
+        }
+    }
+    return time;
+}
+
+/**
+ * Discard every profiling data.
+ * */
+
+void resetProfile(){
+    pendingEvents.clear();
+    profile.clear();
+}
+
+/**
+ * Print the per-stage breakdown of the device time.
+ * */
+
+void printProfile(){
+    collectProfile();
+    const char* stageNames[] = {"Host to device", "Kernel", "Device to host"};
+
+    /**
+     * Compute the total device time, shared among all stages.
+     * */
+
+    double totalTime = 0;
+    for(int stage = HOST_TO_DEVICE; stage <= DEVICE_TO_HOST; stage++){
+        totalTime += getStageTime((ProfileStage) stage);
+    }
+
+    std::cout << "Device profile: " << std::endl;
+    for(int stage = HOST_TO_DEVICE; stage <= DEVICE_TO_HOST; stage++){
+
+        /**
+         * Print the total time of the stage.
+         * */
+
+        double stageTime = getStageTime((ProfileStage) stage);
+        std::cout << "\t" << stageNames[stage] << ": " << stageTime << " ms ("
+        << (totalTime > 0 ? 100 * stageTime / totalTime : 0) << "\%);" << std::endl;
+
+        /**
+         * Print the mean times of each command of the stage.
+         * */
+
+        for(auto it = profile.begin(); it != profile.end(); it++){
+            if(it->first.first != stage){
+                continue;
+            }
+            const CommandProfile& command = it->second;
+            std::cout << "\t\t" << it->first.second << ": " << command.count << " commands, "
+            << command.runMs / command.count << " ms run, "
+            << command.queuedMs / command.count << " ms queued, "
+            << command.submitMs / command.count << " ms submitted (mean);" << std::endl;
+        }
+    }
+}
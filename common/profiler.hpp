@@ -0,0 +1,54 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <CL/cl.hpp>
+#include <map>
+#include <string>
+
+// =================================================================
+// ---------------------- Profiler Structures ----------------------
+// =================================================================
+
+/**
+ * Stages of the work submitted to the device.
+ * */
+
+enum ProfileStage {
+    HOST_TO_DEVICE,     // Writes from host memory to device buffers.
+    KERNEL,             // Kernel executions.
+    DEVICE_TO_HOST      // Reads from device buffers to host memory.
+};
+
+/**
+ * Accumulated profiling data of every command with the same label.
+ * */
+
+struct CommandProfile {
+    size_t count = 0;       // The number of commands.
+    double queuedMs = 0;    // The total time between CL_PROFILING_COMMAND_QUEUED and SUBMIT.
+    double submitMs = 0;    // The total time between CL_PROFILING_COMMAND_SUBMIT and START.
+    double runMs = 0;       // The total time between CL_PROFILING_COMMAND_START and END.
+};
+
+typedef std::map<std::pair<ProfileStage, std::string>, CommandProfile> Profile;
+
+// =================================================================
+// ---------------------- Profiler Functions -----------------------
+// =================================================================
+
+cl::Event* profileEvent(ProfileStage stage,
+                        const std::string& label);  // Return an event to be passed to an enqueue call.
+
+void collectProfile();                              // Wait for the recorded commands and accumulate their events.
+
+void collectProfileIfFull();                        // Collect the recorded events if there are many of them.
+
+Profile getProfile();                               // Return the accumulated profiling data.
+
+double getStageTime(ProfileStage stage);            // Return the total run time of a stage, in ms.
+
+void resetProfile();                                // Discard every profiling data.
+
+void printProfile();                                // Print the per-stage breakdown of the device time.
+
+#endif
@@ -0,0 +1,183 @@
+#include "program_cache.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+// =================================================================
+// ------------------------ Auxiliary Functions --------------------
+// =================================================================
+
+/**
+ * Return the directory where program binaries are cached. An empty
+ * OPENCL_CACHE_DIR disables the cache.
+ * */
+
+static std::string getCacheDir(){
+    const char* dir = getenv("OPENCL_CACHE_DIR");
+    return dir ? std::string(dir) : std::string(".opencl_cache");
+}
+
+/**
+ * Return the path of the cache file associated with a key.
+ * */
+
+static std::string getCachePath(const std::string& key){
+    return getCacheDir() + "/" + key + ".bin";
+}
+
+/**
+ * Compute the 64-bit FNV-1a hash of a string. Unlike std::hash, its
+ * value is stable across compilers and runs.
+ * */
+
+static unsigned long long fnv1a(const std::string& data){
+    unsigned long long hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < data.size(); i++){
+        hash ^= (unsigned char) data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// =================================================================
+// --------------------- Program Cache Functions -------------------
+// =================================================================
+
+/**
+ * Hash source, options, device and driver into a cache key.
+ * */
+
+std::string getProgramCacheKey(const cl::Device& device, const std::string& src, const std::string& options){
+
+    /**
+     * Any change in the kernel source, the build options, the device or
+     * its driver must produce a different key.
+     * */
+
+    std::string id = src + '\0' + options + '\0'
+                   + device.getInfo<CL_DEVICE_NAME>() + '\0'
+                   + device.getInfo<CL_DEVICE_VERSION>() + '\0'
+                   + device.getInfo<CL_DRIVER_VERSION>();
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", fnv1a(id));
+    return std::string(key);
+}
+
+/**
+ * Build a program from a cached binary, if there is one.
+ * */
+
+bool loadProgramBinary(const cl::Context& context, const cl::Device& device, const std::string& key, const std::string& options, cl::Program& program){
+
+    /**
+     * Read the cached binary, if the cache is enabled and has it.
+     * */
+
+    if(getCacheDir().empty()){
+        return false;
+    }
+
+    std::ifstream binFile(getCachePath(key), std::ios::binary);
+    if(!binFile){
+        return false;
+    }
+    std::vector<unsigned char> bin((std::istreambuf_iterator<char>(binFile)), std::istreambuf_iterator<char>());
+    if(bin.empty()){
+        return false;
+    }
+
+    /**
+     * Create the program from the binary. It still has to be built, but
+     * that no longer involves compiling the OpenCL C source.
+     * */
+
+    std::vector<cl::Device> devices(1, device);
+    cl::Program::Binaries binaries(1, std::make_pair((const void*) bin.data(), bin.size()));
+    std::vector<cl_int> binStatus;
+    cl_int err;
+    cl::Program cached(context, devices, binaries, &binStatus, &err);
+    if(err != CL_SUCCESS || binStatus.empty() || binStatus[0] != CL_SUCCESS){
+        return false;
+    }
+
+    if(cached.build(devices, options.c_str()) != CL_BUILD_SUCCESS){
+        return false;
+    }
+
+    program = cached;
+    return true;
+}
+
+/**
+ * Save the binary of a built program into the cache.
+ * */
+
+void storeProgramBinary(const std::string& key, const cl::Program& program){
+
+    /**
+     * Create the cache directory if it does not exist yet.
+     * */
+
+    std::string dir = getCacheDir();
+    if(dir.empty()){
+        return;
+    }
+
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+
+    /**
+     * Query the binary of the program (built for a single device).
+     * */
+
+    size_t binSize = 0;
+    if(clGetProgramInfo(program(), CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binSize, NULL) != CL_SUCCESS || binSize == 0){
+        return;
+    }
+
+    std::vector<unsigned char> bin(binSize);
+    unsigned char* binPtr = bin.data();
+    if(clGetProgramInfo(program(), CL_PROGRAM_BINARIES, sizeof(unsigned char*), &binPtr, NULL) != CL_SUCCESS){
+        return;
+    }
+
+    /**
+     * Write it to a temporary file of this process and rename it
+     * afterwards, so that concurrent processes never read a partially
+     * written binary nor write to the same temporary file.
+     * */
+
+    std::string path = getCachePath(key);
+    std::string tmpPath = path + "." + std::to_string((long) getpid()) + ".tmp";
+    std::ofstream binFile(tmpPath, std::ios::binary);
+    binFile.write((const char*) bin.data(), bin.size());
+    binFile.close();
+    if(!binFile){
+        std::cerr << "Warning: could not write program cache file " << tmpPath << std::endl;
+        std::remove(tmpPath.c_str());
+        return;
+    }
+
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if(std::rename(tmpPath.c_str(), path.c_str()) != 0){
+        std::remove(tmpPath.c_str());
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef PROGRAM_CACHE_HPP
+#define PROGRAM_CACHE_HPP
+
+#include <CL/cl.hpp>
+#include <string>
+
+// =================================================================
+// --------------------- Program Cache Functions -------------------
+// =================================================================
+
+std::string getProgramCacheKey(const cl::Device& device,
+                               const std::string& src,
+                               const std::string& options);     // Hash source, options, device and driver into a cache key.
+
+bool loadProgramBinary(const cl::Context& context,
+                       const cl::Device& device,
+                       const std::string& key,
+                       const std::string& options,
+                       cl::Program& program);                   // Build a program from a cached binary, if there is one.
+
+void storeProgramBinary(const std::string& key,
+                        const cl::Program& program);            // Save the binary of a built program into the cache.
+
+#endif
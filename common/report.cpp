@@ -0,0 +1,269 @@
+#include "report.hpp"
+#include "buffer_pool.hpp"
+#include "options.hpp"
+#include "profiler.hpp"
+#include "runtime.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// =================================================================
+// ------------------------ Report State ---------------------------
+// =================================================================
+
+/**
+ * A parameter of the record, whose value is kept already formatted.
+ * */
+
+struct ReportParameter {
+    std::string name;       // The name of the parameter.
+    std::string value;      // The formatted value of the parameter.
+    bool numeric;           // Whether the value is a number.
+};
+
+static std::string exampleName;                     // The name of the example being reported.
+static std::vector<ReportParameter> parameters;     // The problem and work-group sizes.
+static std::vector<BenchmarkResult> benchmarks;     // The benchmark statistics.
+
+// =================================================================
+// ------------------------ Auxiliary Functions --------------------
+// =================================================================
+
+/**
+ * Quote a string as a JSON string.
+ * */
+
+static std::string toJson(const std::string& text){
+    std::ostringstream out;
+    out << '"';
+    for(size_t i = 0; i < text.size(); i++){
+        char c = text[i];
+        if(c == '"' || c == '\\'){
+            out << '\\' << c;
+        } else if((unsigned char) c < 0x20){
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else{
+            out << c;
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+/**
+ * Quote a string as a CSV field, if needed.
+ * */
+
+static std::string toCsv(const std::string& text){
+    if(text.find_first_of(",\"\n") == std::string::npos){
+        return text;
+    }
+    std::string quoted = "\"";
+    for(size_t i = 0; i < text.size(); i++){
+        quoted += text[i] == '"' ? std::string("\"\"") : std::string(1, text[i]);
+    }
+    return quoted + "\"";
+}
+
+/**
+ * Write the record as a single-line JSON object.
+ * */
+
+static void writeJson(std::ostream& out, bool verified){
+    BufferPoolStats pool = getBufferPoolStats();
+    Profile profile = getProfile();
+
+    out << "{\"example\":" << toJson(exampleName)
+        << ",\"device\":" << toJson(device.getInfo<CL_DEVICE_NAME>())
+        << ",\"driver\":" << toJson(device.getInfo<CL_DRIVER_VERSION>())
+        << ",\"verified\":" << (verified ? "true" : "false");
+
+    /**
+     * Problem and work-group sizes.
+     * */
+
+    out << ",\"parameters\":{";
+    for(size_t i = 0; i < parameters.size(); i++){
+        out << (i ? "," : "") << toJson(parameters[i].name) << ":"
+            << (parameters[i].numeric ? parameters[i].value : toJson(parameters[i].value));
+    }
+    out << "}";
+
+    /**
+     * Wall-clock statistics of each benchmark.
+     * */
+
+    out << ",\"benchmarks\":[";
+    for(size_t i = 0; i < benchmarks.size(); i++){
+        const BenchmarkResult& result = benchmarks[i];
+        out << (i ? "," : "") << "{\"name\":" << toJson(result.name)
+            << ",\"warmup\":" << result.warmup
+            << ",\"repetitions\":" << result.repetitions
+            << ",\"min_ms\":" << result.minMs
+            << ",\"median_ms\":" << result.medianMs
+            << ",\"mean_ms\":" << result.meanMs
+            << ",\"p95_ms\":" << result.p95Ms
+            << ",\"p99_ms\":" << result.p99Ms
+            << ",\"stddev_ms\":" << result.stddevMs
+            << ",\"throughput\":" << result.throughput
+            << ",\"throughput_unit\":" << toJson(getThroughputUnitName(result.unit)) << "}";
+    }
+    out << "]";
+
+    /**
+     * Device time of each stage and command.
+     * */
+
+    out << ",\"stages\":{\"host_to_device_ms\":" << getStageTime(HOST_TO_DEVICE)
+        << ",\"kernel_ms\":" << getStageTime(KERNEL)
+        << ",\"device_to_host_ms\":" << getStageTime(DEVICE_TO_HOST) << "}";
+
+    const char* stageNames[] = {"host_to_device", "kernel", "device_to_host"};
+    out << ",\"commands\":[";
+    for(auto it = profile.begin(); it != profile.end(); it++){
+        out << (it == profile.begin() ? "" : ",") << "{\"stage\":" << toJson(stageNames[it->first.first])
+            << ",\"label\":" << toJson(it->first.second)
+            << ",\"count\":" << it->second.count
+            << ",\"run_ms\":" << it->second.runMs
+            << ",\"queued_ms\":" << it->second.queuedMs
+            << ",\"submit_ms\":" << it->second.submitMs << "}";
+    }
+    out << "]";
+
+    /**
+     * Device memory used by the buffer pool.
+     * */
+
+    out << ",\"buffer_pool\":{\"requests\":" << pool.requests
+        << ",\"hits\":" << pool.hits
+        << ",\"peak_bytes\":" << pool.peakBytesResident << "}";
+
+    out << "}" << std::endl;
+}
+
+/**
+ * Write the record as CSV rows, one per benchmark.
+ * */
+
+static void writeCsv(std::ostream& out, bool header, bool verified){
+    if(header){
+        out << "example,device,driver,parameters,benchmark,warmup,repetitions,min_ms,median_ms,mean_ms,p95_ms,p99_ms,stddev_ms,"
+            << "throughput,throughput_unit,host_to_device_ms,kernel_ms,device_to_host_ms,verified" << std::endl;
+    }
+
+    /**
+     * Join the parameters into a single name=value;... field.
+     * */
+
+    std::string joined;
+    for(size_t i = 0; i < parameters.size(); i++){
+        joined += (i ? ";" : "") + parameters[i].name + "=" + parameters[i].value;
+    }
+
+    for(size_t i = 0; i < benchmarks.size(); i++){
+        const BenchmarkResult& result = benchmarks[i];
+        out << toCsv(exampleName) << ","
+            << toCsv(device.getInfo<CL_DEVICE_NAME>()) << ","
+            << toCsv(device.getInfo<CL_DRIVER_VERSION>()) << ","
+            << toCsv(joined) << ","
+            << toCsv(result.name) << ","
+            << result.warmup << "," << result.repetitions << ","
+            << result.minMs << "," << result.medianMs << "," << result.meanMs << ","
+            << result.p95Ms << "," << result.p99Ms << "," << result.stddevMs << ","
+            << result.throughput << "," << getThroughputUnitName(result.unit) << ","
+            << getStageTime(HOST_TO_DEVICE) << "," << getStageTime(KERNEL) << "," << getStageTime(DEVICE_TO_HOST) << ","
+            << (verified ? "true" : "false") << std::endl;
+    }
+}
+
+// =================================================================
+// ------------------------ Report Functions -----------------------
+// =================================================================
+
+/**
+ * Start the structured record of an example run.
+ * */
+
+void beginReport(const std::string& example){
+    exampleName = example;
+    parameters.clear();
+    benchmarks.clear();
+}
+
+/**
+ * Add a textual parameter (e.g. a work-group size).
+ * */
+
+void addReportParameter(const std::string& name, const std::string& value){
+    ReportParameter parameter = {name, value, false};
+    parameters.push_back(parameter);
+}
+
+/**
+ * Add a numeric parameter (e.g. a problem size).
+ * */
+
+void addReportParameter(const std::string& name, double value){
+    std::ostringstream formatted;
+    formatted.precision(15);
+    formatted << value;
+    ReportParameter parameter = {name, formatted.str(), true};
+    parameters.push_back(parameter);
+}
+
+/**
+ * Add the statistics of a benchmark.
+ * */
+
+void addReportBenchmark(const BenchmarkResult& result){
+    benchmarks.push_back(result);
+}
+
+/**
+ * Write the record as set by --format=json|csv (or BENCHMARK_FORMAT) and
+ * --output=path (or BENCHMARK_OUTPUT). Records are appended to the output
+ * file, so several runs can be collected in one file; without an output
+ * file they are printed to the standard output.
+ * */
+
+void writeReport(bool verified){
+    std::string format = getOption("format", "BENCHMARK_FORMAT", "");
+    std::string path = getOption("output", "BENCHMARK_OUTPUT", "");
+    if(format.empty()){
+        return;
+    }
+    if(format != "json" && format != "csv"){
+        std::cerr << "Error!\nUnknown report format: " << format << " (expected json or csv)" << std::endl;
+        exit(1);
+    }
+
+    /**
+     * Open the output file, checking whether a CSV header is needed.
+     * */
+
+    std::ofstream file;
+    bool header = true;
+    if(!path.empty()){
+        std::ifstream existing(path);
+        header = !existing || existing.peek() == std::ifstream::traits_type::eof();
+        file.open(path, std::ios::app);
+        if(!file){
+            std::cerr << "Error!\nCould not open report file: " << path << std::endl;
+            exit(1);
+        }
+    }
+    std::ostream& out = path.empty() ? std::cout : file;
+
+    std::streamsize precision = out.precision(9);
+    if(format == "json"){
+        writeJson(out, verified);
+    } else{
+        writeCsv(out, header, verified);
+    }
+    out.precision(precision);
+}
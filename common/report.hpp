@@ -0,0 +1,24 @@
+#ifndef REPORT_HPP
+#define REPORT_HPP
+
+#include <string>
+
+#include "benchmark.hpp"
+
+// =================================================================
+// ------------------------ Report Functions -----------------------
+// =================================================================
+
+void beginReport(const std::string& example);           // Start the structured record of an example run.
+
+void addReportParameter(const std::string& name,
+                        const std::string& value);      // Add a textual parameter (e.g. a work-group size).
+
+void addReportParameter(const std::string& name,
+                        double value);                  // Add a numeric parameter (e.g. a problem size).
+
+void addReportBenchmark(const BenchmarkResult& result); // Add the statistics of a benchmark.
+
+void writeReport(bool verified);                        // Write the record as set by --format and --output.
+
+#endif
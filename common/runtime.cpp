@@ -0,0 +1,343 @@
+#include "runtime.hpp"
+#include "buffer_pool.hpp"
+#include "device_selector.hpp"
+#include "options.hpp"
+#include "profiler.hpp"
+#include "program_cache.hpp"
+
+#ifdef EMBED_KERNELS
+#include "embedded_kernels.hpp"
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+cl::Program program;    // The default program that will run on the device.
+cl::Context context;    // The context which holds the device.
+cl::Device device;      // The device where the kernels will run.
+cl::CommandQueue queue; // The command queue shared by all kernels.
+
+// =================================================================
+// ------------------------ Runtime Caches -------------------------
+// =================================================================
+
+static std::map<std::string, cl::Program> programs;                         // Programs indexed by kernel file (or name) and options.
+static std::map<std::pair<cl_program, std::string>, cl::Kernel> kernels;   // Kernels indexed by program and name.
+static std::vector<cl::CommandQueue> streamQueues;                          // Extra command queues, created on demand.
+static std::vector<void (*)()> releaseHooks;                                // Functions run by the next releaseDevice.
+
+// =================================================================
+// ------------------------ OpenCL Functions -----------------------
+// =================================================================
+
+/**
+ * Return the device chosen by --device=selector or the OPENCL_DEVICE
+ * environment variable (see selectDevice), or the first device found
+ * in the first OpenCL platform when neither is set.
+ * */
+
+cl::Device getDefaultDevice(){
+    return selectDevice(getOption("device", "OPENCL_DEVICE", ""));
+}
+
+/**
+ * Inicialize device, queue and compile kernel code.
+ * */
+
+void initializeDevice(const std::string& kernelFile){
+
+    /**
+     * Select the device and create its context and command queue
+     * only once per process.
+     * */
+
+    if(device() == NULL){
+        device = getDefaultDevice();
+        context = cl::Context(device);
+        queue = cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE);
+    }
+
+    /**
+     * Compile the default kernel program.
+     * */
+
+    program = buildProgram(kernelFile);
+}
+
+/**
+ * Return the source of a kernel file. When the examples are compiled with
+ * -DEMBED_KERNELS (after running tools/embed_kernels.sh), the sources are
+ * embedded in the executable and no file is read, unless the environment
+ * variable OPENCL_KERNEL_DIR points to a directory to read them from
+ * (e.g. while developing the kernels). Otherwise, the file is read from
+ * the working directory.
+ * */
+
+std::string loadKernelSource(const std::string& kernelFile){
+
+    /**
+     * Search the embedded sources, unless they are overridden.
+     * */
+
+    const char* kernelDir = getenv("OPENCL_KERNEL_DIR");
+#ifdef EMBED_KERNELS
+    for(size_t i = 0; kernelDir == NULL && i < EMBEDDED_KERNELS_COUNT; i++){
+        if(kernelFile == EMBEDDED_KERNELS[i][0]){
+            return EMBEDDED_KERNELS[i][1];
+        }
+    }
+#endif
+
+    /**
+     * Read OpenCL kernel file as a string.
+     * */
+
+    std::string path = kernelDir ? std::string(kernelDir) + "/" + kernelFile : kernelFile;
+    std::ifstream kernel_file(path);
+    if(!kernel_file){
+        std::cerr << "Error!\nCould not open kernel file: " << path << std::endl;
+        exit(1);
+    }
+    return std::string(std::istreambuf_iterator<char>(kernel_file), (std::istreambuf_iterator<char>()));
+}
+
+/**
+ * Check if the device supports an OpenCL extension (e.g. cl_khr_fp64).
+ * */
+
+bool hasDeviceExtension(const std::string& extension){
+    std::string extensions = " " + device.getInfo<CL_DEVICE_EXTENSIONS>() + " ";
+    return extensions.find(" " + extension + " ") != std::string::npos;
+}
+
+/**
+ * Return the alignment of host memory usable in place by the device
+ * (with CL_MEM_USE_HOST_PTR): its base address alignment, and at least
+ * a page, which some drivers require to avoid copying the memory.
+ * */
+
+size_t getHostAlignment(){
+    return std::max<size_t>(4096, device.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8);
+}
+
+/**
+ * Check if host memory can be used in place by the device: it must start
+ * at a multiple of getHostAlignment() and span whole cache lines.
+ * */
+
+bool isHostAligned(const void* ptr, size_t size){
+    return (uintptr_t) ptr % getHostAlignment() == 0 && size % 64 == 0;
+}
+
+/**
+ * Allocate host memory that the device can use in place, rounding its
+ * size up to whole cache lines. The address of the underlying allocation
+ * is stored right before the returned one.
+ * */
+
+void* allocateHostMemory(size_t size){
+    size_t alignment = getHostAlignment();
+    char* raw = (char*) malloc((size + 63) / 64 * 64 + alignment + sizeof(void*));
+    if(raw == NULL){
+        std::cerr << "Error!\nCould not allocate " << size << " bytes of host memory." << std::endl;
+        exit(1);
+    }
+
+    char* aligned = (char*) (((uintptr_t) (raw + sizeof(void*)) + alignment - 1) / alignment * alignment);
+    ((void**) aligned)[-1] = raw;
+    return aligned;
+}
+
+/**
+ * Free memory returned by allocateHostMemory.
+ * */
+
+void freeHostMemory(void* ptr){
+    if(ptr != NULL){
+        free(((void**) ptr)[-1]);
+    }
+}
+
+/**
+ * Compile a kernel file once per process.
+ * */
+
+cl::Program& buildProgram(const std::string& kernelFile, const std::string& options){
+
+    /**
+     * Return the program if it has already been compiled with the same options.
+     * */
+
+    std::string key = kernelFile + "\n" + options;
+    auto cached = programs.find(key);
+    if(cached != programs.end()){
+        return cached->second;
+    }
+
+    /**
+     * Read OpenCL kernel source as a string and compile it.
+     * */
+
+    return buildProgramFromSource(kernelFile, loadKernelSource(kernelFile), options);
+}
+
+/**
+ * Compile a kernel source once per process, indexing it by name (e.g. its
+ * file, or the signature of a generated kernel) and options.
+ * */
+
+cl::Program& buildProgramFromSource(const std::string& name, const std::string& src, const std::string& options){
+
+    /**
+     * Return the program if it has already been compiled with the same options.
+     * */
+
+    std::string key = name + "\n" + options;
+    auto cached = programs.find(key);
+    if(cached != programs.end()){
+        return cached->second;
+    }
+
+    /**
+     * Load the program from the on-disk binary cache, if it has
+     * already been compiled for this device by a previous run.
+     * */
+
+    std::string binKey = getProgramCacheKey(device, src, options);
+    cl::Program compiled;
+    if(loadProgramBinary(context, device, binKey, options, compiled)){
+        return programs[key] = compiled;
+    }
+
+    /**
+     * Otherwise, compile kernel program which will run on the device.
+     * */
+
+    cl::Program::Sources sources(1, std::make_pair(src.c_str(), src.length() + 1));
+    compiled = cl::Program(context, sources);
+
+    auto err = compiled.build(std::vector<cl::Device>(1, device), options.c_str());
+    if(err != CL_BUILD_SUCCESS){
+        std::cerr << "Error!\nBuild Status: " << compiled.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device) 
+        << "\nBuild Log:\t " << compiled.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
+        exit(1);
+    }
+
+    /**
+     * Store its binary so that the next runs skip the compilation.
+     * */
+
+    storeProgramBinary(binKey, compiled);
+    return programs[key] = compiled;
+}
+
+/**
+ * Return an extra command queue of the device, created (with profiling,
+ * as the default queue) on the first request of each index. Commands in
+ * different queues may overlap, e.g. the transfers of one chunk of data
+ * with the computation of another.
+ * */
+
+cl::CommandQueue& getStreamQueue(size_t index){
+    while(streamQueues.size() <= index){
+        streamQueues.push_back(cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE));
+    }
+    return streamQueues[index];
+}
+
+/**
+ * Return a kernel of the default program.
+ * */
+
+cl::Kernel& getKernel(const std::string& kernelName){
+    return getKernel(program, kernelName);
+}
+
+/**
+ * Return a kernel created once per program.
+ * */
+
+cl::Kernel& getKernel(const cl::Program& kernelProgram, const std::string& kernelName){
+
+    /**
+     * Return the kernel if it has already been created.
+     * */
+
+    auto key = std::make_pair(kernelProgram(), kernelName);
+    auto cached = kernels.find(key);
+    if(cached != kernels.end()){
+        return cached->second;
+    }
+
+    /**
+     * Create the kernel object.
+     * */
+
+    cl_int err;
+    cl::Kernel kernel(kernelProgram, kernelName.c_str(), &err);
+    if(err != CL_SUCCESS){
+        std::cerr << "Error!\nCould not create kernel: " << kernelName << " (" << err << ")" << std::endl;
+        exit(1);
+    }
+
+    return kernels[key] = kernel;
+}
+
+/**
+ * Run a function on the next releaseDevice, before the runtime releases its
+ * kernels and programs. Modules built on the runtime (e.g. the expression
+ * engine) register one to drop the OpenCL objects they cache, so that the
+ * runtime does not depend on them. Hooks run once: a module registers again
+ * when it caches new objects.
+ * */
+
+void addReleaseHook(void (*hook)()){
+    releaseHooks.push_back(hook);
+}
+
+/**
+ * Release every object held by the runtime.
+ * */
+
+void releaseDevice(){
+
+    /**
+     * Wait for pending commands before releasing anything.
+     * */
+
+    if(queue() != NULL){
+        queue.finish();
+    }
+    for(size_t i = 0; i < streamQueues.size(); i++){
+        streamQueues[i].finish();
+    }
+
+    /**
+     * Release profiling events, pooled buffers, the objects of the modules
+     * built on the runtime, and kernels before the programs they were
+     * created from.
+     * */
+
+    resetProfile();
+    clearBufferPool();
+    for(size_t i = 0; i < releaseHooks.size(); i++){
+        releaseHooks[i]();
+    }
+    releaseHooks.clear();
+    kernels.clear();
+    streamQueues.clear();
+    programs.clear();
+    program = cl::Program();
+    queue = cl::CommandQueue();
+    context = cl::Context();
+    device = cl::Device();
+}
@@ -0,0 +1,54 @@
+#ifndef RUNTIME_HPP
+#define RUNTIME_HPP
+
+#include <CL/cl.hpp>
+#include <string>
+
+// =================================================================
+// ------------------------ Global Variables ------------------------
+// =================================================================
+
+extern cl::Program program;     // The default program that will run on the device.
+extern cl::Context context;     // The context which holds the device.
+extern cl::Device device;       // The device where the kernels will run.
+extern cl::CommandQueue queue;  // The command queue shared by all kernels.
+
+// =================================================================
+// ------------------------ OpenCL Functions -----------------------
+// =================================================================
+
+cl::Device getDefaultDevice();                                  // Return the device selected by --device or OPENCL_DEVICE.
+
+void initializeDevice(const std::string& kernelFile);           // Inicialize device, queue and compile kernel code.
+
+std::string loadKernelSource(const std::string& kernelFile);    // Return the source of a kernel file (embedded or read).
+
+bool hasDeviceExtension(const std::string& extension);          // Check if the device supports an OpenCL extension.
+
+size_t getHostAlignment();                                      // Return the alignment of host memory usable in place by the device.
+
+bool isHostAligned(const void* ptr, size_t size);               // Check if host memory can be used in place by the device.
+
+void* allocateHostMemory(size_t size);                          // Allocate host memory that the device can use in place.
+
+void freeHostMemory(void* ptr);                                 // Free memory returned by allocateHostMemory.
+
+cl::Program& buildProgram(const std::string& kernelFile,
+                          const std::string& options = "");     // Compile a kernel file once per process.
+
+cl::Program& buildProgramFromSource(const std::string& name,
+                                    const std::string& src,
+                                    const std::string& options = ""); // Compile a kernel source once per process.
+
+cl::CommandQueue& getStreamQueue(size_t index);                 // Return an extra command queue of the device (for overlapping).
+
+cl::Kernel& getKernel(const std::string& kernelName);           // Return a kernel of the default program.
+
+cl::Kernel& getKernel(const cl::Program& kernelProgram,
+                      const std::string& kernelName);           // Return a kernel created once per program.
+
+void addReleaseHook(void (*hook)());                            // Run a function on the next releaseDevice (to drop objects built on the runtime).
+
+void releaseDevice();                                           // Release every object held by the runtime.
+
+#endif
@@ -1,3 +1,12 @@
+/**
+ * Declare the size of each cached submatrix (it must be the same work-group 
+ * size used by the host code, which may override it with -D SUB_SIZE).
+ */
+
+#ifndef SUB_SIZE
+#define SUB_SIZE 16
+#endif
+
 /**
  * This kernel function converts an RBG image to grayscale.
  */
@@ -105,13 +114,6 @@ __kernel void filterImageWithCache(const unsigned int maskSize,
                             __constant float* mask,
                             __global unsigned char* outputImg){
 
-    /**
-     * Declare the size of each submatrix (it must be 
-     * the same work-group size declared in the host code).
-     */
-
-    const int SUB_SIZE = 16;
-
     /**
      * Get work-item identifiers.
      */
@@ -1,10 +1,15 @@
 #include <CL/cl.hpp>
-#include <fstream>
 #include <iostream>
 #include <string.h>
-#include <time.h>
 
 #include "CImg.h"
+#include "../common/autotuner.hpp"
+#include "../common/benchmark.hpp"
+#include "../common/buffer_pool.hpp"
+#include "../common/options.hpp"
+#include "../common/profiler.hpp"
+#include "../common/report.hpp"
+#include "../common/runtime.hpp"
 using namespace cimg_library;
 
 // =================================================================
@@ -47,10 +52,6 @@ void displayImg(unsigned char *img, int imgWidth, int imgHeight);   // Display u
 // ------------------------ OpenCL Functions -----------------------
 // =================================================================
 
-cl::Device getDefaultDevice();                                    // Return a device found in this OpenCL platform.
-
-void initializeDevice();                                          // Inicialize device and compile kernel code.
-
 void parFilter(unsigned int imgWidth,                       
                unsigned int imgHeight,
                unsigned int lpMaskSize,
@@ -62,25 +63,35 @@ void parFilter(unsigned int imgWidth,
                float *hpMask,
                unsigned char *outputImg);                        // Parallelly filter an image.
 
+void tuneWorkGroupSize(unsigned int imgWidth,                       
+                       unsigned int imgHeight,
+                       unsigned int lpMaskSize,
+                       unsigned int hpMaskSize,
+                       unsigned char *inputRchannel,
+                       unsigned char *inputGchannel,
+                       unsigned char *inputBchannel,
+                       float *lpMask,
+                       float *hpMask,
+                       unsigned char *outputImg);                // Select the fastest work-group size for this device and image size.
+
 // =================================================================
 // ------------------------ Global Variables ------------------------
 // =================================================================
 
-cl::Program program;                // The program that will run on the device.    
-cl::Context context;                // The context which holds the device.    
-cl::Device device;                  // The device where the kernel will run.
+size_t WG_SIZE[2] = {16, 16};       // The size of work-groups (the SUB_SIZE of the filter kernel).
 
 // =================================================================
 // ------------------------- Main Function -------------------------
 // =================================================================
 
-int main(){
+int main(int argc, char** argv){
 
     /**
-     * Create auxiliary variables.
+     * Read the benchmark options.
      * */
 
-    clock_t start, end;
+    parseOptions(argc, argv);
+    BenchmarkOptions options = getBenchmarkOptions(5);
 
     /**
      * Load input image.
@@ -92,6 +103,10 @@ int main(){
     unsigned char *inputRchannel = &inputImg[0];
     unsigned char *inputGchannel = &inputImg[imgWidth*imgHeight];
     unsigned char *inputBchannel = &inputImg[2*imgWidth*imgHeight];
+    const double PIXELS = (double) imgWidth * imgHeight;
+    beginReport("image_filtering");
+    addReportParameter("width", imgWidth);
+    addReportParameter("height", imgHeight);
 
     /**
      * Create a low-pass filter mask.
@@ -132,27 +147,34 @@ int main(){
      * Sequentially convolve filter over image.
      * */
 
-    start = clock();
-    seqFilter(imgWidth, imgHeight, lpMaskSize, hpMaskSize, inputRchannel, inputGchannel, inputBchannel, 
-    lpMaskData, hpMaskData, seqFilteredImg);
-    end = clock();
-    double seqTime = ((double) 10e3 * (end - start)) / CLOCKS_PER_SEC;
+    BenchmarkResult seqResult = runBenchmark("Sequential", [&]{
+        seqFilter(imgWidth, imgHeight, lpMaskSize, hpMaskSize, inputRchannel, inputGchannel, inputBchannel, 
+        lpMaskData, hpMaskData, seqFilteredImg);
+    }, options, PIXELS, MEGAPIXELS_PER_SECOND);
 
     /**
      * Initialize OpenCL device.
      */
 
-    initializeDevice();
+    initializeDevice("image_filtering.cl");
+
+    /**
+     * Select the work-group size (tuned now with --tune, or by a
+     * previous run).
+     * */
+
+    tuneWorkGroupSize(imgWidth, imgHeight, lpMaskSize, hpMaskSize, inputRchannel, inputGchannel, inputBchannel, 
+    lpMaskData, hpMaskData, parFilteredImg);
+    addReportParameter("local_size", std::to_string(WG_SIZE[0]) + "x" + std::to_string(WG_SIZE[1]));
 
     /**
      * Parallelly convolve filter over image.
      * */
     
-    start = clock();
-    parFilter(imgWidth, imgHeight, lpMaskSize, hpMaskSize, inputRchannel, inputGchannel, inputBchannel, 
-    lpMaskData, hpMaskData, parFilteredImg);
-    end = clock();
-    double parTime = ((double) 10e3 * (end - start)) / CLOCKS_PER_SEC;
+    BenchmarkResult parResult = runBenchmark("Parallel", [&]{
+        parFilter(imgWidth, imgHeight, lpMaskSize, hpMaskSize, inputRchannel, inputGchannel, inputBchannel, 
+        lpMaskData, hpMaskData, parFilteredImg);
+    }, options, PIXELS, MEGAPIXELS_PER_SECOND);
     
     /**
      * Check if outputs are equal.
@@ -165,95 +187,40 @@ int main(){
      */
 
     std::cout << "Status: " << (equal ? "SUCCESS!" : "FAILED!") << std::endl;
-    std::cout << "Mean execution time: \n\tSequential: " << seqTime << " ms;\n\tParallel: " << parTime << " ms." << std::endl;
-    std::cout << "Performance gain: " << (100 * (seqTime - parTime) / parTime) << "\%\n";
+    std::cout << "Execution time: " << std::endl;
+    printBenchmark(seqResult);
+    printBenchmark(parResult);
+    std::cout << "Performance gain: " << (100 * (seqResult.medianMs - parResult.medianMs) / parResult.medianMs) << "\%\n";
+    printBufferPoolStats();
+    printProfile();
 
     /**
-     * Display filtered image.
+     * Write the structured record of this run, if requested.
      * */
-    
-    displayImg(parFilteredImg, imgWidth, imgHeight);
-    return 0;
-}
-
-// =================================================================
-// ------------------------ OpenCL Functions -----------------------
-// =================================================================
 
-/**
- * Return a device found in this OpenCL platform.
- * */
+    addReportBenchmark(seqResult);
+    addReportBenchmark(parResult);
+    writeReport(equal);
 
-cl::Device getDefaultDevice(){
-    
     /**
-     * Search for all the OpenCL platforms available and check
-     * if there are any.
+     * Display filtered image (unless running unattended).
      * */
-
-    std::vector<cl::Platform> platforms;
-    cl::Platform::get(&platforms);
-
-    if (platforms.empty()){
-        std::cerr << "No platforms found!" << std::endl;
-        exit(1);
-    }
-
-    /**
-     * Search for all the devices on the first platform 
-     * and check if there are any available.
-     * */
-
-    auto platform = platforms.front();
-    std::vector<cl::Device> devices;
-    platform.getDevices(CL_DEVICE_TYPE_ALL, &devices);
-
-    if (devices.empty()){
-        std::cerr << "No devices found!" << std::endl;
-        exit(1);
+    
+    if(!hasFlag("no-display")){
+        displayImg(parFilteredImg, imgWidth, imgHeight);
     }
 
     /**
-     * Return the first device found.
+     * Release OpenCL objects.
      * */
 
-    return devices.front();
+    releaseDevice();
+    return 0;
 }
 
-/**
- * Inicialize device and compile kernel code.
- * */
-
-void initializeDevice(){
-
-    /**
-     * Select the first available device.
-     * */
-
-    device = getDefaultDevice();
-    
-    /**
-     * Read OpenCL kernel file as a string.
-     * */
-
-    std::ifstream kernel_file("image_filtering.cl");
-    std::string src(std::istreambuf_iterator<char>(kernel_file), (std::istreambuf_iterator<char>()));
-
-    /**
-     * Compile kernel program which will run on the device.
-     * */
-
-    cl::Program::Sources sources(1, std::make_pair(src.c_str(), src.length() + 1));
-    context = cl::Context(device);
-    program = cl::Program(context, sources);
-    
-    auto err = program.build();
-    if(err != CL_BUILD_SUCCESS){
-        std::cerr << "Error!\nBuild Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device) 
-        << "\nBuild Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
-        exit(1);
-    }
-}
+// =================================================================
+// ------------------------ OpenCL Functions -----------------------
+// =================================================================
 
 /**
  * Parallelly filter an image.
@@ -274,53 +241,134 @@ void parFilter(unsigned int imgWidth,
      * Create buffers and allocate memory on the device.
      * */
 
-    cl::Buffer inputRchannelBuf(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, imgWidth * imgHeight * sizeof(unsigned char), inputRchannel);
-    cl::Buffer inputGchannelBuf(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, imgWidth * imgHeight * sizeof(unsigned char), inputGchannel);
-    cl::Buffer inputBchannelBuf(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, imgWidth * imgHeight * sizeof(unsigned char), inputBchannel);
-    cl::Buffer grayOutputBuf(context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, imgWidth * imgHeight * sizeof(unsigned char));
-    cl::Buffer lpMaskBuf(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, lpMaskSize * lpMaskSize * sizeof(float), lpMask);
-    cl::Buffer hpMaskBuf(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, hpMaskSize * hpMaskSize * sizeof(float), hpMask);
-    cl::Buffer lpOutputBuf(context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, imgWidth * imgHeight * sizeof(unsigned char));
-    cl::Buffer hpOutputBuf(context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, imgWidth * imgHeight * sizeof(unsigned char));
+    const size_t imgSize = imgWidth * imgHeight * sizeof(unsigned char);
+    cl::Buffer inputRchannelBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, imgSize);
+    cl::Buffer inputGchannelBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, imgSize);
+    cl::Buffer inputBchannelBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, imgSize);
+    cl::Buffer grayOutputBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, imgSize);
+    cl::Buffer lpMaskBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, lpMaskSize * lpMaskSize * sizeof(float));
+    cl::Buffer hpMaskBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, hpMaskSize * hpMaskSize * sizeof(float));
+    cl::Buffer lpOutputBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, imgSize);
+    cl::Buffer hpOutputBuf = acquireBuffer(CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, imgSize);
+
+    /**
+     * Transfer the input image and the masks to the device.
+     * */
+
+    queue.enqueueWriteBuffer(inputRchannelBuf, CL_FALSE, 0, imgSize, inputRchannel, NULL, profileEvent(HOST_TO_DEVICE, "write R channel"));
+    queue.enqueueWriteBuffer(inputGchannelBuf, CL_FALSE, 0, imgSize, inputGchannel, NULL, profileEvent(HOST_TO_DEVICE, "write G channel"));
+    queue.enqueueWriteBuffer(inputBchannelBuf, CL_FALSE, 0, imgSize, inputBchannel, NULL, profileEvent(HOST_TO_DEVICE, "write B channel"));
+    queue.enqueueWriteBuffer(lpMaskBuf, CL_FALSE, 0, lpMaskSize * lpMaskSize * sizeof(float), lpMask, NULL, profileEvent(HOST_TO_DEVICE, "write lpMask"));
+    queue.enqueueWriteBuffer(hpMaskBuf, CL_FALSE, 0, hpMaskSize * hpMaskSize * sizeof(float), hpMask, NULL, profileEvent(HOST_TO_DEVICE, "write hpMask"));
 
     /**
      * Initialize grayscale kernel.
      * */
 
-    cl::Kernel grayKernel(program, "rgb2gray");
+    cl::Kernel& grayKernel = getKernel("rgb2gray");
     grayKernel.setArg(0, inputRchannelBuf);
     grayKernel.setArg(1, inputGchannelBuf);
     grayKernel.setArg(2, inputBchannelBuf);
     grayKernel.setArg(3, grayOutputBuf);
 
     /**
-     * Initialize low-pass filter kernel.
+     * Convert the input image to grayscale.
+     * */
+
+    queue.enqueueNDRangeKernel(grayKernel, cl::NullRange, cl::NDRange(imgWidth, imgHeight), cl::NullRange, NULL, profileEvent(KERNEL, "rgb2gray"));
+
+    /**
+     * Apply the low-pass filter (kernel arguments are captured
+     * at enqueue time, so the same kernel object is reused below).
      * */
-    cl::Kernel lpKernel(program, "filterImageWithCache");
-    lpKernel.setArg(0, sizeof(unsigned int), &lpMaskSize);
-    lpKernel.setArg(1, grayOutputBuf);
-    lpKernel.setArg(2, lpMaskBuf);
-    lpKernel.setArg(3, lpOutputBuf);
+
+    cl::Kernel& filterKernel = getKernel("filterImageWithCache");
+    filterKernel.setArg(0, sizeof(unsigned int), &lpMaskSize);
+    filterKernel.setArg(1, grayOutputBuf);
+    filterKernel.setArg(2, lpMaskBuf);
+    filterKernel.setArg(3, lpOutputBuf);
+    queue.enqueueNDRangeKernel(filterKernel, cl::NullRange, cl::NDRange(imgWidth, imgHeight), cl::NDRange(WG_SIZE[0], WG_SIZE[1]), NULL, profileEvent(KERNEL, "filterImageWithCache (low-pass)"));
 
     /**
-     * Initialize high-pass filter kernel.
+     * Apply the high-pass filter and collect the final result.
      * */
 
-    cl::Kernel hpKernel(program, "filterImageWithCache");
-    hpKernel.setArg(0, sizeof(unsigned int), &hpMaskSize);
-    hpKernel.setArg(1, lpOutputBuf);
-    hpKernel.setArg(2, hpMaskBuf);
-    hpKernel.setArg(3, hpOutputBuf);
+    filterKernel.setArg(0, sizeof(unsigned int), &hpMaskSize);
+    filterKernel.setArg(1, lpOutputBuf);
+    filterKernel.setArg(2, hpMaskBuf);
+    filterKernel.setArg(3, hpOutputBuf);
+    queue.enqueueNDRangeKernel(filterKernel, cl::NullRange, cl::NDRange(imgWidth, imgHeight), cl::NDRange(WG_SIZE[0], WG_SIZE[1]), NULL, profileEvent(KERNEL, "filterImageWithCache (high-pass)"));
+    queue.enqueueReadBuffer(hpOutputBuf, CL_TRUE, 0, imgSize, outputImg, NULL, profileEvent(DEVICE_TO_HOST, "read output image"));
 
     /**
-     * Execute kernel functions and collect the final result.
+     * Give the buffers back to the pool.
      * */
 
-    cl::CommandQueue queue(context, device);
-    queue.enqueueNDRangeKernel(grayKernel, cl::NullRange, cl::NDRange(imgWidth, imgHeight));
-    queue.enqueueNDRangeKernel(lpKernel, cl::NullRange, cl::NDRange(imgWidth, imgHeight), cl::NDRange(16, 16));
-    queue.enqueueNDRangeKernel(hpKernel, cl::NullRange, cl::NDRange(imgWidth, imgHeight), cl::NDRange(16, 16));
-    queue.enqueueReadBuffer(hpOutputBuf, CL_TRUE, 0, imgWidth * imgHeight * sizeof(unsigned char), outputImg);
+    releaseBuffer(inputRchannelBuf);
+    releaseBuffer(inputGchannelBuf);
+    releaseBuffer(inputBchannelBuf);
+    releaseBuffer(grayOutputBuf);
+    releaseBuffer(lpMaskBuf);
+    releaseBuffer(hpMaskBuf);
+    releaseBuffer(lpOutputBuf);
+    releaseBuffer(hpOutputBuf);
+}
+
+/**
+ * Select the fastest work-group size for this device and image size.
+ */
+
+void tuneWorkGroupSize(unsigned int imgWidth,
+                       unsigned int imgHeight,
+                       unsigned int lpMaskSize,
+                       unsigned int hpMaskSize,
+                       unsigned char *inputRchannel,
+                       unsigned char *inputGchannel,
+                       unsigned char *inputBchannel,
+                       float *lpMask,
+                       float *hpMask,
+                       unsigned char *outputImg){
+
+    /**
+     * Keep the square work-groups that evenly divide the image and
+     * whose cached submatrix covers the masks, and that the device
+     * can run, given the one pixel cached per work-item.
+     * */
+
+    std::vector<int> tiles;
+    const int TILES[] = {8, 16, 32};
+    for(int i = 0; i < 3; i++){
+        if(imgWidth % TILES[i] == 0 && imgHeight % TILES[i] == 0 
+        && TILES[i] >= (int) lpMaskSize && TILES[i] >= (int) hpMaskSize){
+            tiles.push_back(TILES[i]);
+        }
+    }
+    std::vector<int> candidates = getTileCandidates("image_filtering.cl", "filterImageWithCache", tiles, sizeof(unsigned char));
+
+    /**
+     * Time each candidate, compiled with it as SUB_SIZE.
+     */
+
+    BenchmarkOptions tuning;
+    tuning.warmup = 1;
+    tuning.repetitions = 5;
+    std::string bucket = getSizeBucket(imgWidth) + "x" + getSizeBucket(imgHeight);
+    int tile = autotune("filterImageWithCache", bucket, candidates, 16, [&](int candidate){
+        WG_SIZE[0] = WG_SIZE[1] = candidate;
+        program = buildProgram("image_filtering.cl", getTileOptions(candidate));
+        return runBenchmark("Tuning", [&]{
+            parFilter(imgWidth, imgHeight, lpMaskSize, hpMaskSize, inputRchannel, inputGchannel, inputBchannel, 
+            lpMask, hpMask, outputImg);
+        }, tuning).medianMs;
+    });
+
+    /**
+     * Use the selected work-group size and discard the tuning profile.
+     */
+
+    WG_SIZE[0] = WG_SIZE[1] = tile;
+    program = buildProgram("image_filtering.cl", getTileOptions(tile));
+    resetProfile();
 }
 
 // =================================================================
@@ -454,6 +502,13 @@ void seqFilter(unsigned int imgWidth,
      */
 
     seqConvolve(imgWidth, imgHeight, hpMaskSize, lpOut, hpMask, outputImg);
+
+    /**
+     * Free the intermediate images.
+     */
+
+    free(grayOut);
+    free(lpOut);
 }
 
 /**
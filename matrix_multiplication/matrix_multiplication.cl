@@ -1,10 +1,37 @@
+/**
+ * Declare the element type (int by default), which the host overrides with
+ * -D ELEMENT_TYPE (and -D ENABLE_FP64 for double). Half matrices (built with
+ * HALF_STORAGE, or ELEMENT_TYPE=half and ENABLE_FP16 on devices with
+ * cl_khr_fp16) are only stored as half: they are read and written with
+ * vload_half and vstore_half, and their products are summed as float.
+ **/
+
+#ifdef ENABLE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#if defined(HALF_STORAGE) || defined(ENABLE_FP16)
+#define STORAGE_TYPE half
+#define ACCUMULATOR_TYPE float
+#define LOAD(p, i) vload_half((i), (p))
+#define STORE(p, i, v) vstore_half((v), (i), (p))
+#else
+#ifndef ELEMENT_TYPE
+#define ELEMENT_TYPE int
+#endif
+#define STORAGE_TYPE ELEMENT_TYPE
+#define ACCUMULATOR_TYPE ELEMENT_TYPE
+#define LOAD(p, i) ((p)[i])
+#define STORE(p, i, v) ((p)[i] = (v))
+#endif
+
 /**
  * This kernel function multiplies two matrices a[M,K] and b[K,N].
  **/
 
-__kernel void multiplyMatrices(__global int* a,
-                                    __global int* b,
-                                    __global int* c,
+__kernel void multiplyMatrices(__global STORAGE_TYPE* a,
+                                    __global STORAGE_TYPE* b,
+                                    __global STORAGE_TYPE* c,
                                     const int M, 
                                     const int N, 
                                     const int K){
@@ -21,9 +48,9 @@ __kernel void multiplyMatrices(__global int* a,
      * Compute element c[rowIndex, colIndex].
      **/
 
-    int sum = 0;
+    ACCUMULATOR_TYPE sum = 0;
     for(int k = 0; k < K; k++){
-        sum += a[rowIndex*K + k] * b[k*N + colIndex];
+        sum += LOAD(a, rowIndex*K + k) * LOAD(b, k*N + colIndex);
     }
-    c[index] = sum;
+    STORE(c, index, sum);
 }
@@ -1,14 +1,22 @@
 #include <CL/cl.hpp>
-#include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "../common/benchmark.hpp"
+#include "../common/buffer_pool.hpp"
+#include "../common/element_type.hpp"
+#include "../common/options.hpp"
+#include "../common/profiler.hpp"
+#include "../common/report.hpp"
+#include "../common/runtime.hpp"
 
 // =================================================================
 // ---------------------- Secondary Functions ----------------------
 // =================================================================
 
-cl::Device getDefaultDevice();        // Return the first device found in this OpenCL platform.
-void initializeDevice();              // Inicialize device and compile kernel code.
 void seqMultiplyMatrices(int* a, 
                         int* b, 
                         int* c, 
@@ -25,27 +33,27 @@ bool checkEquality(int* c1,
                     int* c2, 
                     const int M, 
                     const int N);     // Check if the matrices c1 and c2 are equal.
-
-// =================================================================
-// ------------------------ Global Variables ------------------------
-// =================================================================
-
-cl::Program program;    // The program that will run on the device.    
-cl::Context context;    // The context which holds the device.    
-cl::Device device;      // The device where the kernel will run.
+template<class T>
+void parMultiplyMatricesOf(const T* a, const T* b, T* c,
+                           const int M, const int N,
+                           const int K);            // Parallelly performs c[M,N] = a[M,K] * b[K,N] over matrices of T.
+template<class T>
+bool benchmarkMatricesOf(const int M, const int N, const int K,
+                         const BenchmarkOptions& options,
+                         std::vector<BenchmarkResult>& results); // Benchmark parMultiplyMatricesOf<T> and check its result.
 
 // =================================================================
 // ------------------------- Main Function -------------------------
 // =================================================================
 
-int main(){
+int main(int argc, char** argv){
     
     /**
-     * Create auxiliary variables.
+     * Read the benchmark options.
      * */
 
-    clock_t start, end;
-    const int EXECUTIONS = 40;
+    parseOptions(argc, argv);
+    BenchmarkOptions options = getBenchmarkOptions(40);
     
     /**
      * Prepare input constants related to the dimensions of the matrices.
@@ -54,6 +62,12 @@ int main(){
     const int M = 1 << 4;
     const int N = 1 << 4;
     const int K = 1 << 12;
+    const double FLOPS = 2.0 * M * N * K;
+    beginReport("matrix_multiplication");
+    addReportParameter("M", M);
+    addReportParameter("N", N);
+    addReportParameter("K", K);
+    addReportParameter("local_size", "auto");
 
     /**
      * Prepare input matrices A and B.
@@ -80,125 +94,78 @@ int main(){
      * Sequentially multiply matrices.
      * */
 
-    start = clock();
-    for(int i = 0; i < EXECUTIONS; i++){
+    BenchmarkResult seqResult = runBenchmark("Sequential", [&]{
         seqMultiplyMatrices(a.data(), b.data(), cs.data(), M, N, K);
-    }
-    end = clock();
-    double seqTime = ((double) 10e3 * (end - start)) / CLOCKS_PER_SEC / EXECUTIONS;
+    }, options, FLOPS, GIGAFLOPS_PER_SECOND);
 
     /**
      * Initialize OpenCL device.
      * */
 
-    initializeDevice();
+    initializeDevice("matrix_multiplication.cl");
 
     /**
      * Parallelly multiply matrices.
      * */
 
-    start = clock();
-    for(int i = 0; i < EXECUTIONS; i++){
+    BenchmarkResult parResult = runBenchmark("Parallel", [&]{
         parMultiplyMatrices(a.data(), b.data(), cp.data(), M, N, K);
-    }
-    end = clock();
-    double parTime = ((double) 10e3 * (end - start)) / CLOCKS_PER_SEC / EXECUTIONS;
+    }, options, FLOPS, GIGAFLOPS_PER_SECOND);
 
     /**
-     * Check if outputs are equal.
+     * Parallelly multiply matrices of the floating-point types, so that
+     * their throughputs can be compared.
      * */
 
-    bool equal = checkEquality(cs.data(), cp.data(), ROWS_C, COLS_C);
+    std::vector<BenchmarkResult> typedResults;
+    bool typedEqual = benchmarkMatricesOf<float>(M, N, K, options, typedResults);
+    typedEqual = benchmarkMatricesOf<double>(M, N, K, options, typedResults) && typedEqual;
+    typedEqual = benchmarkMatricesOf<Half>(M, N, K, options, typedResults) && typedEqual;
 
     /**
-     * Print results.
+     * Check if outputs are equal.
      * */
 
-    std::cout << "Status: " << (equal ? "SUCCESS!" : "FAILED!") << std::endl;
-    std::cout << "Results: \n\tA[0] = " << a[0] << "\n\tB[0] = " << b[0] << "\n\tC[0] = " << cp[0] << std::endl;
-    std::cout << "Mean execution time: \n\tSequential: " << seqTime << " ms;\n\tParallel: " << parTime << " ms." << std::endl;
-    std::cout << "Performance gain: " << (100 * (seqTime - parTime) / parTime) << "\%\n";
-    return 0;
-}
-
-// =================================================================
-// ---------------------- Secondary Functions ----------------------
-// =================================================================
-
-/**
- * Return the first device found in this OpenCL platform.
- * */
+    bool equal = checkEquality(cs.data(), cp.data(), ROWS_C, COLS_C) && typedEqual;
 
-cl::Device getDefaultDevice(){
-    
     /**
-     * Search for all the OpenCL platforms available and check
-     * if there are any.
+     * Print results.
      * */
 
-    std::vector<cl::Platform> platforms;
-    cl::Platform::get(&platforms);
-
-    if (platforms.empty()){
-        std::cerr << "No platforms found!" << std::endl;
-        exit(1);
+    std::cout << "Status: " << (equal ? "SUCCESS!" : "FAILED!") << std::endl;
+    std::cout << "Results: \n\tA[0] = " << a[0] << "\n\tB[0] = " << b[0] << "\n\tC[0] = " << cp[0] << std::endl;
+    std::cout << "Execution time: " << std::endl;
+    printBenchmark(seqResult);
+    printBenchmark(parResult);
+    std::cout << "Performance gain: " << (100 * (seqResult.medianMs - parResult.medianMs) / parResult.medianMs) << "\%\n";
+    for(size_t i = 0; i < typedResults.size(); i++){
+        printBenchmark(typedResults[i]);
     }
+    printBufferPoolStats();
+    printProfile();
 
     /**
-     * Search for all the devices on the first platform and check if
-     * there are any available.
+     * Write the structured record of this run, if requested.
      * */
 
-    auto platform = platforms.front();
-    std::vector<cl::Device> devices;
-    platform.getDevices(CL_DEVICE_TYPE_ALL, &devices);
-
-    if (devices.empty()){
-        std::cerr << "No devices found!" << std::endl;
-        exit(1);
+    addReportBenchmark(seqResult);
+    addReportBenchmark(parResult);
+    for(size_t i = 0; i < typedResults.size(); i++){
+        addReportBenchmark(typedResults[i]);
     }
+    writeReport(equal);
 
     /**
-     * Return the first device found.
+     * Release OpenCL objects.
      * */
 
-    return devices.front();
+    releaseDevice();
+    return 0;
 }
 
-/**
- * Inicialize device and compile kernel code.
- * */
-
-void initializeDevice(){
-
-    /**
-     * Select the first available device.
-     * */
-
-    device = getDefaultDevice();
-    
-    /**
-     * Read OpenCL kernel file as a string.
-     * */
-
-    std::ifstream kernel_file("matrix_multiplication.cl");
-    std::string src(std::istreambuf_iterator<char>(kernel_file), (std::istreambuf_iterator<char>()));
-
-    /**
-     * Compile kernel program which will run on the device.
-     * */
-
-    cl::Program::Sources sources(1, std::make_pair(src.c_str(), src.length() + 1));
-    context = cl::Context(device);
-    program = cl::Program(context, sources);
-    
-    auto err = program.build();
-    if(err != CL_BUILD_SUCCESS){
-        std::cerr << "Error!\nBuild Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device) 
-        << "\nBuild Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
-        exit(1);
-    }
-}
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
 
 /**
  * Sequentially performs the operation c[M,N] = a[M,K] * b[K,N].
@@ -232,15 +199,17 @@ void parMultiplyMatrices(int* a, int* b, int* c,
      * Create buffers and allocate memory on the device.
      * */
 
-    cl::Buffer aBuf(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, M * K * sizeof(int), a);
-    cl::Buffer bBuf(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, K * N * sizeof(int), b);
-    cl::Buffer cBuf(context, CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY, M * N * sizeof(int));
+    cl::Buffer aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, M * K * sizeof(int));
+    cl::Buffer bBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, K * N * sizeof(int));
+    cl::Buffer cBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY, M * N * sizeof(int));
+    queue.enqueueWriteBuffer(aBuf, CL_FALSE, 0, M * K * sizeof(int), a, NULL, profileEvent(HOST_TO_DEVICE, "write a"));
+    queue.enqueueWriteBuffer(bBuf, CL_FALSE, 0, K * N * sizeof(int), b, NULL, profileEvent(HOST_TO_DEVICE, "write b"));
 
     /**
      * Set kernel arguments.
      * */
 
-    cl::Kernel kernel(program, "multiplyMatrices");
+    cl::Kernel& kernel = getKernel("multiplyMatrices");
     kernel.setArg(0, aBuf);
     kernel.setArg(1, bBuf);
     kernel.setArg(2, cBuf);
@@ -252,10 +221,77 @@ void parMultiplyMatrices(int* a, int* b, int* c,
      * Execute the kernel function and collect its result.
      * */
 
-    cl::CommandQueue queue(context, device, CL_QUEUE_PROFILING_ENABLE);
-    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(N, M));
-    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, M * N * sizeof(int), c);
-    queue.finish();
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(N, M), cl::NullRange, NULL, profileEvent(KERNEL, "multiplyMatrices"));
+    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, M * N * sizeof(int), c, NULL, profileEvent(DEVICE_TO_HOST, "read c"));
+
+    /**
+     * Give the buffers back to the pool.
+     * */
+
+    releaseBuffer(aBuf);
+    releaseBuffer(bBuf);
+    releaseBuffer(cBuf);
+}
+
+/**
+ * Parallelly performs the operation c[M,N] = a[M,K] * b[K,N] over
+ * matrices of T, with the program of matrix_multiplication.cl built for T (once per type).
+ * */
+
+template<class T>
+void parMultiplyMatricesOf(const T* a, const T* b, T* c,
+                           const int M,
+                           const int N,
+                           const int K){
+
+    /**
+     * Get the kernel compiled for T.
+     * */
+
+    cl::Kernel& kernel = getKernel(buildProgram("matrix_multiplication.cl", ElementType<T>::options()), "multiplyMatrices");
+
+    /**
+     * Create buffers and allocate memory on the device.
+     * */
+
+    cl::Buffer aBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, M * K * sizeof(T));
+    cl::Buffer bBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, K * N * sizeof(T));
+    cl::Buffer cBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY, M * N * sizeof(T));
+    std::string name = ElementType<T>::name();
+    queue.enqueueWriteBuffer(aBuf, CL_FALSE, 0, M * K * sizeof(T), a, NULL, profileEvent(HOST_TO_DEVICE, "write a (" + name + ")"));
+    queue.enqueueWriteBuffer(bBuf, CL_FALSE, 0, K * N * sizeof(T), b, NULL, profileEvent(HOST_TO_DEVICE, "write b (" + name + ")"));
+
+    /**
+     * Execute the kernel function and collect its result.
+     * */
+
+    kernel.setArg(0, aBuf);
+    kernel.setArg(1, bBuf);
+    kernel.setArg(2, cBuf);
+    kernel.setArg(3, M);
+    kernel.setArg(4, N);
+    kernel.setArg(5, K);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(N, M), cl::NullRange, NULL, profileEvent(KERNEL, "multiplyMatrices (" + name + ")"));
+    queue.enqueueReadBuffer(cBuf, CL_TRUE, 0, M * N * sizeof(T), c, NULL, profileEvent(DEVICE_TO_HOST, "read c (" + name + ")"));
+
+    releaseBuffer(aBuf);
+    releaseBuffer(bBuf);
+    releaseBuffer(cBuf);
+}
+
+/**
+ * Benchmark parMultiplyMatricesOf<T> over matrices of the given shape,
+ * appending its result to results, and check it against seqMultiplyMatricesOf<T>.
+ * */
+
+template<class T>
+bool benchmarkMatricesOf(const int M, const int N, const int K,
+                         const BenchmarkOptions& options,
+                         std::vector<BenchmarkResult>& results){
+    return benchmarkElementType<T>((size_t) M * K, (size_t) K * N, (size_t) M * N,
+        [&](const T* a, const T* b, T* c){ seqMultiplyMatricesOf(a, b, c, M, N, K); },
+        [&](const T* a, const T* b, T* c){ parMultiplyMatricesOf(a, b, c, M, N, K); },
+        options, 2.0 * M * N * K, GIGAFLOPS_PER_SECOND, results);
 }
 
 /**
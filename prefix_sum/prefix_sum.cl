@@ -0,0 +1,120 @@
+/**
+ * Declare the element type and the work-group size (a power of two, which
+ * must be the same used by the host code). Each work-group scans a block of
+ * 2 * GROUP_SIZE elements. The host overrides them with -D ELEMENT_TYPE and
+ * -D GROUP_SIZE.
+ */
+
+#ifndef ELEMENT_TYPE
+#define ELEMENT_TYPE int
+#endif
+
+#ifndef GROUP_SIZE
+#define GROUP_SIZE 256
+#endif
+
+#define BLOCK_SIZE (2 * GROUP_SIZE)
+
+/**
+ * This kernel function scans each block of 2 * GROUP_SIZE elements of an
+ * array with the work-efficient (Blelloch) algorithm: an up-sweep builds a
+ * tree of partial sums in local memory, and a down-sweep turns it into the
+ * exclusive scan of the block. The inclusive scan adds each element to its
+ * exclusive one. The sum of each block is stored in blockSums, so that the
+ * host can scan those and add them to the blocks (see addBlockOffsets).
+ */
+
+__kernel void scanBlocks(__global ELEMENT_TYPE* in,
+                         __global ELEMENT_TYPE* out,
+                         __global ELEMENT_TYPE* blockSums,
+                         const int N,
+                         const int inclusive){
+
+    /**
+     * Load the two elements of this work-item into local memory
+     * (elements past the end of the array are zeros).
+     */
+
+    __local ELEMENT_TYPE temp[BLOCK_SIZE];
+    int localIndex = get_local_id(0);
+    int base = get_group_id(0) * BLOCK_SIZE;
+    int first = base + localIndex;
+    int second = base + localIndex + GROUP_SIZE;
+    ELEMENT_TYPE firstValue = first < N ? in[first] : 0;
+    ELEMENT_TYPE secondValue = second < N ? in[second] : 0;
+    temp[localIndex] = firstValue;
+    temp[localIndex + GROUP_SIZE] = secondValue;
+
+    /**
+     * Up-sweep: sum pairs of nodes of the tree, level by level.
+     */
+
+    int offset = 1;
+    for(int d = GROUP_SIZE; d > 0; d >>= 1){
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if(localIndex < d){
+            int i = offset * (2 * localIndex + 1) - 1;
+            int j = offset * (2 * localIndex + 2) - 1;
+            temp[j] += temp[i];
+        }
+        offset <<= 1;
+    }
+
+    /**
+     * Store the sum of the block, which is the root of the tree, and
+     * replace it by zero (the exclusive scan of the first element).
+     */
+
+    if(localIndex == 0){
+        blockSums[get_group_id(0)] = temp[BLOCK_SIZE - 1];
+        temp[BLOCK_SIZE - 1] = 0;
+    }
+
+    /**
+     * Down-sweep: pass each node's prefix to its children, level by level.
+     */
+
+    for(int d = 1; d < BLOCK_SIZE; d <<= 1){
+        offset >>= 1;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if(localIndex < d){
+            int i = offset * (2 * localIndex + 1) - 1;
+            int j = offset * (2 * localIndex + 2) - 1;
+            ELEMENT_TYPE t = temp[i];
+            temp[i] = temp[j];
+            temp[j] += t;
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /**
+     * Store the scan of the two elements of this work-item.
+     */
+
+    if(first < N){
+        out[first] = inclusive ? temp[localIndex] + firstValue : temp[localIndex];
+    }
+    if(second < N){
+        out[second] = inclusive ? temp[localIndex + GROUP_SIZE] + secondValue : temp[localIndex + GROUP_SIZE];
+    }
+}
+
+/**
+ * This kernel function adds to every element of each block of 2 * GROUP_SIZE
+ * elements the sum of all the previous blocks (the exclusive scan of the
+ * block sums), which completes the scan of an array longer than one block.
+ */
+
+__kernel void addBlockOffsets(__global ELEMENT_TYPE* out,
+                              __global ELEMENT_TYPE* offsets,
+                              const int N){
+    ELEMENT_TYPE offset = offsets[get_group_id(0)];
+    int first = get_group_id(0) * BLOCK_SIZE + get_local_id(0);
+    int second = first + GROUP_SIZE;
+    if(first < N){
+        out[first] += offset;
+    }
+    if(second < N){
+        out[second] += offset;
+    }
+}
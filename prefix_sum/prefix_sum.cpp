@@ -0,0 +1,262 @@
+#include <CL/cl.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../common/benchmark.hpp"
+#include "../common/buffer_pool.hpp"
+#include "../common/element_type.hpp"
+#include "../common/options.hpp"
+#include "../common/profiler.hpp"
+#include "../common/report.hpp"
+#include "../common/runtime.hpp"
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+size_t getGroupSize();                                      // Return the work-group size of the scan kernels.
+template<class T>
+void seqScan(const T* in, T* out, const int N,
+             bool inclusive);                               // Sequentially scans the N-dimensional array in.
+template<class T>
+void parScan(const T* in, T* out, const int N,
+             bool inclusive);                               // Parallelly scans the N-dimensional array in.
+template<class T>
+void parScanBuffer(const cl::Buffer& in, const cl::Buffer& out,
+                   const int N, bool inclusive);            // Parallelly scans an N-dimensional array on the device.
+template<class T>
+bool benchmarkScans(const int N,
+                    const BenchmarkOptions& options,
+                    std::vector<BenchmarkResult>& results); // Benchmark the exclusive and inclusive scans of N elements of T.
+
+// =================================================================
+// ------------------------- Main Function -------------------------
+// =================================================================
+
+int main(int argc, char** argv){
+
+    /**
+     * Read the benchmark options.
+     * */
+
+    parseOptions(argc, argv);
+    BenchmarkOptions options = getBenchmarkOptions(10);
+
+    /**
+     * Prepare the array sizes: a single block, two levels of blocks,
+     * and three levels of blocks (with a partial last block).
+     * */
+
+    const int SIZES[] = {500, 1 << 20, (1 << 24) + 1000};
+    const int SIZES_COUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+    beginReport("prefix_sum");
+    std::string sizes;
+    for(int i = 0; i < SIZES_COUNT; i++){
+        sizes += (i > 0 ? "," : "") + std::to_string(SIZES[i]);
+    }
+    addReportParameter("N", sizes);
+
+    /**
+     * Initialize OpenCL device.
+     * */
+
+    initializeDevice("prefix_sum.cl");
+    addReportParameter("local_size", getGroupSize());
+
+    /**
+     * Sequentially and parallelly scan arrays of each type and size
+     * (the results are stored in sequential and parallel pairs).
+     * */
+
+    std::vector<BenchmarkResult> results;
+    bool equal = true;
+    for(int i = 0; i < SIZES_COUNT; i++){
+        equal = benchmarkScans<int>(SIZES[i], options, results) && equal;
+        equal = benchmarkScans<float>(SIZES[i], options, results) && equal;
+    }
+
+    /**
+     * Print results.
+     * */
+
+    std::cout << "Status: " << (equal ? "SUCCESS!" : "FAILED!") << std::endl;
+    std::cout << "Execution time: " << std::endl;
+    for(size_t i = 0; i + 1 < results.size(); i += 2){
+        printBenchmark(results[i]);
+        printBenchmark(results[i + 1]);
+        std::cout << "Performance gain: " << (100 * (results[i].medianMs - results[i + 1].medianMs) / results[i + 1].medianMs) << "\%\n";
+    }
+    printBufferPoolStats();
+    printProfile();
+
+    /**
+     * Write the structured record of this run, if requested.
+     * */
+
+    for(size_t i = 0; i < results.size(); i++){
+        addReportBenchmark(results[i]);
+    }
+    writeReport(equal);
+
+    /**
+     * Release OpenCL objects.
+     * */
+
+    releaseDevice();
+    return 0;
+}
+
+// =================================================================
+// ---------------------- Secondary Functions ----------------------
+// =================================================================
+
+/**
+ * Return the work-group size of the scan kernels: the greatest power of
+ * two up to 256 that the device supports (the scan tree of each block
+ * has 2 * getGroupSize() leaves).
+ * */
+
+size_t getGroupSize(){
+    size_t maxSize = std::min<size_t>(256, device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>());
+    size_t groupSize = 1;
+    while(groupSize * 2 <= maxSize){
+        groupSize *= 2;
+    }
+    return groupSize;
+}
+
+/**
+ * Sequentially scans the N-dimensional array in: out[i] is the sum of the
+ * elements before in[i] (exclusive scan) or up to in[i] (inclusive scan).
+ * */
+
+template<class T>
+void seqScan(const T* in, T* out, const int N, bool inclusive){
+    T sum = 0;
+    for(int i = 0; i < N; i++){
+        T value = in[i];
+        out[i] = inclusive ? sum + value : sum;
+        sum += value;
+    }
+}
+
+/**
+ * Parallelly scans the N-dimensional array in.
+ * */
+
+template<class T>
+void parScan(const T* in, T* out, const int N, bool inclusive){
+    if(N <= 0){
+        return;
+    }
+
+    /**
+     * Allocate device memory and transfer the input.
+     * */
+
+    cl::Buffer inBuf = acquireBuffer(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, N * sizeof(T));
+    cl::Buffer outBuf = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY, N * sizeof(T));
+    queue.enqueueWriteBuffer(inBuf, CL_FALSE, 0, N * sizeof(T), in, NULL, profileEvent(HOST_TO_DEVICE, "write in"));
+
+    /**
+     * Scan the array and collect the result.
+     * */
+
+    parScanBuffer<T>(inBuf, outBuf, N, inclusive);
+    queue.enqueueReadBuffer(outBuf, CL_TRUE, 0, N * sizeof(T), out, NULL, profileEvent(DEVICE_TO_HOST, "read out"));
+
+    releaseBuffer(inBuf);
+    releaseBuffer(outBuf);
+}
+
+/**
+ * Parallelly scans an N-dimensional array on the device. Each work-group
+ * scans a block of 2 * getGroupSize() elements and stores its sum; if there
+ * is more than one block, their sums are scanned the same way (so any N
+ * takes a few levels) and added to the blocks that follow them. The queue
+ * is in-order, so temporary buffers go back to the pool as soon as the
+ * commands using them are enqueued.
+ * */
+
+template<class T>
+void parScanBuffer(const cl::Buffer& in, const cl::Buffer& out, const int N, bool inclusive){
+
+    /**
+     * Get the kernels compiled for T.
+     * */
+
+    const size_t GROUP_SIZE = getGroupSize();
+    cl::Program& scanProgram = buildProgram("prefix_sum.cl", ElementType<T>::options() + " -D GROUP_SIZE=" + std::to_string(GROUP_SIZE));
+    cl::Kernel& scanKernel = getKernel(scanProgram, "scanBlocks");
+    cl::Kernel& offsetKernel = getKernel(scanProgram, "addBlockOffsets");
+    const int BLOCKS = (N + 2 * GROUP_SIZE - 1) / (2 * GROUP_SIZE);
+
+    /**
+     * Scan every block and store their sums.
+     * */
+
+    cl::Buffer blockSums = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, BLOCKS * sizeof(T));
+    scanKernel.setArg(0, in);
+    scanKernel.setArg(1, out);
+    scanKernel.setArg(2, blockSums);
+    scanKernel.setArg(3, N);
+    scanKernel.setArg(4, inclusive ? 1 : 0);
+    queue.enqueueNDRangeKernel(scanKernel, cl::NullRange, cl::NDRange(BLOCKS * GROUP_SIZE), cl::NDRange(GROUP_SIZE), NULL, profileEvent(KERNEL, "scanBlocks"));
+
+    /**
+     * Add to each block the (exclusive) scan of the sums of the
+     * previous blocks.
+     * */
+
+    if(BLOCKS > 1){
+        cl::Buffer blockOffsets = acquireBuffer(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, BLOCKS * sizeof(T));
+        parScanBuffer<T>(blockSums, blockOffsets, BLOCKS, false);
+
+        offsetKernel.setArg(0, out);
+        offsetKernel.setArg(1, blockOffsets);
+        offsetKernel.setArg(2, N);
+        queue.enqueueNDRangeKernel(offsetKernel, cl::NullRange, cl::NDRange(BLOCKS * GROUP_SIZE), cl::NDRange(GROUP_SIZE), NULL, profileEvent(KERNEL, "addBlockOffsets"));
+        releaseBuffer(blockOffsets);
+    }
+    releaseBuffer(blockSums);
+}
+
+/**
+ * Benchmark the sequential and parallel exclusive and inclusive scans of
+ * N elements of T, appending their results (in sequential and parallel
+ * pairs) to results, and check if they agree.
+ * */
+
+template<class T>
+bool benchmarkScans(const int N, const BenchmarkOptions& options, std::vector<BenchmarkResult>& results){
+
+    /**
+     * Prepare the input and outputs.
+     * */
+
+    std::vector<T> in(N), ss(N), sp(N);
+    for(int i = 0; i < N; i++){
+        in[i] = (T) (((i * 7919LL) % 100) - 50) / (T) 4;
+    }
+    const double BYTES = 2.0 * N * sizeof(T);
+
+    /**
+     * Benchmark both kinds of scan.
+     * */
+
+    bool equal = true;
+    for(int inclusive = 0; inclusive <= 1; inclusive++){
+        const std::string SUFFIX = std::string(inclusive ? " inclusive scan (" : " exclusive scan (") + ElementType<T>::name() + ", N=" + std::to_string(N) + ")";
+        results.push_back(runBenchmark("Sequential" + SUFFIX, [&]{
+            seqScan(in.data(), ss.data(), N, inclusive);
+        }, options, BYTES, GIGABYTES_PER_SECOND));
+        results.push_back(runBenchmark("Parallel" + SUFFIX, [&]{
+            parScan(in.data(), sp.data(), N, inclusive);
+        }, options, BYTES, GIGABYTES_PER_SECOND));
+        equal = checkCloseness(ss.data(), sp.data(), N) && equal;
+    }
+    return equal;
+}
@@ -1,40 +1,32 @@
 #include <CL/cl.hpp>
 #include <iostream>
 
-int main(){
+#include "../common/device_selector.hpp"
+#include "../common/options.hpp"
+#include "../common/runtime.hpp"
 
-    /**
-     * Search for all the OpenCL platforms available and check
-     * if there are any.
-     * */
-
-    std::vector<cl::Platform> platforms;
-    cl::Platform::get(&platforms);
-
-    if (platforms.empty()){
-        std::cerr << "No platforms found!" << std::endl;
-        return -1;
-    }
+int main(int argc, char** argv){
 
     /**
-     * Search for all the devices on the first platform and check if
-     * there are any available.
+     * List all the devices found in every OpenCL platform, with the
+     * "P:D" identifiers accepted by --device and OPENCL_DEVICE.
      * */
 
-    auto platform = platforms.front();
-    std::vector<cl::Device> devices;
-    platform.getDevices(CL_DEVICE_TYPE_ALL, &devices);
+    parseOptions(argc, argv);
+    std::vector<DeviceEntry> entries = getAllDevices();
 
-    if (devices.empty()){
-        std::cerr << "No devices found!" << std::endl;
-        return -1;
+    std::cout << "OpenCL Devices:" << std::endl;
+    for(size_t i = 0; i < entries.size(); i++){
+        std::cout << "\t" << entries[i].platformIndex << ":" << entries[i].deviceIndex
+        << " " << entries[i].device.getInfo<CL_DEVICE_NAME>() << std::endl;
     }
+    std::cout << std::endl;
 
     /**
-     * Select the first device and print its information.
+     * Select a device and print its information.
      * */
 
-    auto device = devices.front();
+    auto device = getDefaultDevice();
     auto name = device.getInfo<CL_DEVICE_NAME>();
     auto vendor = device.getInfo<CL_DEVICE_VENDOR>();
     auto version = device.getInfo<CL_DEVICE_VERSION>();
@@ -0,0 +1,38 @@
+#!/bin/sh
+
+# Generate common/embedded_kernels.hpp, which embeds the OpenCL kernel files
+# of every example as string constants. Compile the examples with
+# -DEMBED_KERNELS to use them instead of reading the .cl files at runtime.
+#
+# Usage: tools/embed_kernels.sh [output header]
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+OUTPUT=${1:-"$ROOT/common/embedded_kernels.hpp"}
+DELIMITER="__CL_SOURCE__"
+
+# Remove the partial header if the generation stops before it is moved.
+trap 'rm -f "$OUTPUT.tmp"' EXIT
+
+{
+    echo "// Generated by tools/embed_kernels.sh. Do not edit."
+    echo "#ifndef EMBEDDED_KERNELS_HPP"
+    echo "#define EMBEDDED_KERNELS_HPP"
+    echo ""
+    echo "#include <cstddef>"
+    echo ""
+    echo "static const char* const EMBEDDED_KERNELS[][2] = {"
+    for FILE in "$ROOT"/*/*.cl; do
+        if grep -q ")$DELIMITER\"" "$FILE"; then
+            echo "Error: $FILE contains the raw string delimiter." >&2
+            exit 1
+        fi
+        printf '    {"%s", R"%s(' "$(basename "$FILE")" "$DELIMITER"
+        cat "$FILE"
+        printf ')%s"},\n' "$DELIMITER"
+    done
+    echo "};"
+    echo ""
+    echo "static const size_t EMBEDDED_KERNELS_COUNT = sizeof(EMBEDDED_KERNELS) / sizeof(EMBEDDED_KERNELS[0]);"
+    echo ""
+    echo "#endif"
+} > "$OUTPUT.tmp" && mv "$OUTPUT.tmp" "$OUTPUT"